@@ -0,0 +1,348 @@
+/*
+ *  SPDX-FileCopyrightText: 2020 The KDE Community
+ *
+ *  SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <QQmlComponent>
+#include <QQmlContext>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QQuickRenderControl>
+#include <QQuickWindow>
+#include <QScopedPointer>
+#include <QtTest>
+
+/**
+ * A column counting how many times the layout moved or resized it.
+ */
+class Column : public QQuickItem
+{
+public:
+    explicit Column(int *geometryChanges)
+        : m_geometryChanges(geometryChanges)
+    {
+        setImplicitSize(300, 400);
+    }
+
+protected:
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override
+    {
+        ++*m_geometryChanges;
+        QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    }
+
+private:
+    int *m_geometryChanges;
+};
+
+class ColumnViewBenchmark : public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void countLayoutPass();
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void benchmarkAddItem_data();
+    void benchmarkAddItem();
+    void benchmarkInsertItem_data();
+    void benchmarkInsertItem();
+    void benchmarkRemoveItem_data();
+    void benchmarkRemoveItem();
+    void benchmarkPop_data();
+    void benchmarkPop();
+    void benchmarkMoveItem_data();
+    void benchmarkMoveItem();
+    void benchmarkScroll_data();
+    void benchmarkScroll();
+
+private:
+    void addColumnsData();
+    void populate(int count);
+    Column *createColumn();
+    void layout();
+    void addItem(QQuickItem *column);
+    void insertItem(int position, QQuickItem *column);
+    QQuickItem *removeItem(const QVariant &column);
+    void report(int operations);
+
+    // The view comes from the plugin, like in applications, so its only copy is the one in there
+    QScopedPointer<QQmlEngine> m_engine;
+    QScopedPointer<QQmlComponent> m_component;
+    // Polishes the window on demand, without rendering it
+    QScopedPointer<QQuickRenderControl> m_renderControl;
+    QScopedPointer<QQuickWindow> m_window;
+    QQuickItem *m_view = nullptr;
+    QList<QQuickItem *> m_columns;
+    int m_geometryChanges = 0;
+    int m_layoutPasses = 0;
+};
+
+void ColumnViewBenchmark::initTestCase()
+{
+    m_engine.reset(new QQmlEngine);
+    m_component.reset(new QQmlComponent(m_engine.data()));
+    m_component->setData(QByteArrayLiteral(R"(
+import QtQuick 2.7
+import org.kde.kirigami 2.7 as Kirigami
+
+Kirigami.ColumnView {
+    width: 1200
+    height: 800
+    columnWidth: 300
+}
+)"), QUrl(QStringLiteral("columnviewbenchmark.qml")));
+    QVERIFY2(m_component->isReady(), qPrintable(m_component->errorString()));
+}
+
+void ColumnViewBenchmark::init()
+{
+    m_renderControl.reset(new QQuickRenderControl);
+    m_window.reset(new QQuickWindow(m_renderControl.data()));
+    m_window->resize(1200, 800);
+
+    m_view = qobject_cast<QQuickItem *>(m_component->create());
+    QVERIFY(m_view);
+    m_view->setParentItem(m_window->contentItem());
+
+    // Every pass, the deferred ones as well as the ones insertItem() does right away
+    QObject *contentItem = m_view->property("contentItem").value<QObject *>();
+    QVERIFY(contentItem);
+    QVERIFY(connect(contentItem, SIGNAL(itemsLaidOut()), this, SLOT(countLayoutPass())));
+
+    m_geometryChanges = 0;
+    m_layoutPasses = 0;
+}
+
+void ColumnViewBenchmark::cleanup()
+{
+    // Before the view, which would otherwise delete them along with its content item
+    qDeleteAll(m_columns);
+    m_columns.clear();
+    delete m_view;
+    m_view = nullptr;
+    m_window.reset();
+    m_renderControl.reset();
+}
+
+void ColumnViewBenchmark::addColumnsData()
+{
+    QTest::addColumn<int>("columns");
+
+    QTest::newRow("10 columns") << 10;
+    QTest::newRow("100 columns") << 100;
+    QTest::newRow("1000 columns") << 1000;
+}
+
+void ColumnViewBenchmark::populate(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        m_columns << createColumn();
+        addItem(m_columns.last());
+    }
+    layout();
+
+    m_geometryChanges = 0;
+    m_layoutPasses = 0;
+}
+
+Column *ColumnViewBenchmark::createColumn()
+{
+    // No parent and C++ ownership: the view gives them back instead of deleting them
+    Column *column = new Column(&m_geometryChanges);
+    QQmlEngine::setContextForObject(column, m_engine->rootContext());
+    return column;
+}
+
+void ColumnViewBenchmark::countLayoutPass()
+{
+    ++m_layoutPasses;
+}
+
+void ColumnViewBenchmark::layout()
+{
+    // What the window does before rendering the next frame: a layout pass only
+    // runs if the view asked for one
+    m_renderControl->polishItems();
+}
+
+void ColumnViewBenchmark::addItem(QQuickItem *column)
+{
+    QMetaObject::invokeMethod(m_view, "addItem", Q_ARG(QQuickItem *, column));
+}
+
+void ColumnViewBenchmark::insertItem(int position, QQuickItem *column)
+{
+    QMetaObject::invokeMethod(m_view, "insertItem", Q_ARG(int, position), Q_ARG(QQuickItem *, column));
+}
+
+QQuickItem *ColumnViewBenchmark::removeItem(const QVariant &column)
+{
+    QQuickItem *removed = nullptr;
+    QMetaObject::invokeMethod(m_view, "removeItem", Q_RETURN_ARG(QQuickItem *, removed), Q_ARG(QVariant, column));
+    return removed;
+}
+
+void ColumnViewBenchmark::report(int operations)
+{
+    if (operations > 0) {
+        qInfo("%.1f column geometry changes and %.1f layout passes per operation",
+              qreal(m_geometryChanges) / operations, qreal(m_layoutPasses) / operations);
+    }
+}
+
+void ColumnViewBenchmark::benchmarkAddItem_data()
+{
+    addColumnsData();
+}
+
+void ColumnViewBenchmark::benchmarkAddItem()
+{
+    QFETCH(int, columns);
+    populate(columns);
+
+    // Pushing a column on top of a full stack, then popping it to get the same stack back
+    QScopedPointer<Column> column(createColumn());
+    int operations = 0;
+    QBENCHMARK {
+        addItem(column.data());
+        layout();
+        removeItem(QVariant::fromValue<QQuickItem *>(column.data()));
+        layout();
+        ++operations;
+    }
+
+    report(operations);
+}
+
+void ColumnViewBenchmark::benchmarkInsertItem_data()
+{
+    addColumnsData();
+}
+
+void ColumnViewBenchmark::benchmarkInsertItem()
+{
+    QFETCH(int, columns);
+    populate(columns);
+
+    // The worst case: every other column moves
+    QScopedPointer<Column> column(createColumn());
+    int operations = 0;
+    QBENCHMARK {
+        insertItem(0, column.data());
+        layout();
+        removeItem(QVariant::fromValue<QQuickItem *>(column.data()));
+        layout();
+        ++operations;
+    }
+
+    report(operations);
+}
+
+void ColumnViewBenchmark::benchmarkRemoveItem_data()
+{
+    addColumnsData();
+}
+
+void ColumnViewBenchmark::benchmarkRemoveItem()
+{
+    QFETCH(int, columns);
+    populate(columns);
+
+    // Removing a column from the middle of the stack, then putting it back
+    const int position = columns / 2;
+    int operations = 0;
+    QBENCHMARK {
+        QQuickItem *column = removeItem(position);
+        layout();
+        insertItem(position, column);
+        layout();
+        ++operations;
+    }
+
+    report(operations);
+}
+
+void ColumnViewBenchmark::benchmarkPop_data()
+{
+    addColumnsData();
+}
+
+void ColumnViewBenchmark::benchmarkPop()
+{
+    QFETCH(int, columns);
+    populate(columns);
+
+    // Popping the top half of the stack at once, then pushing it back
+    QQuickItem *last = m_columns[columns / 2 - 1];
+    const QList<QQuickItem *> popped = m_columns.mid(columns / 2);
+    int operations = 0;
+    QBENCHMARK {
+        QMetaObject::invokeMethod(m_view, "pop", Q_ARG(QQuickItem *, last));
+        layout();
+        for (QQuickItem *column : popped) {
+            addItem(column);
+        }
+        layout();
+        ++operations;
+    }
+
+    report(operations);
+}
+
+void ColumnViewBenchmark::benchmarkMoveItem_data()
+{
+    addColumnsData();
+}
+
+void ColumnViewBenchmark::benchmarkMoveItem()
+{
+    QFETCH(int, columns);
+    populate(columns);
+
+    // Moving the last column to the front and back
+    int operations = 0;
+    QBENCHMARK {
+        QMetaObject::invokeMethod(m_view, "moveItem", Q_ARG(int, columns - 1), Q_ARG(int, 0));
+        layout();
+        QMetaObject::invokeMethod(m_view, "moveItem", Q_ARG(int, 0), Q_ARG(int, columns - 1));
+        layout();
+        operations += 2;
+    }
+
+    report(operations);
+}
+
+void ColumnViewBenchmark::benchmarkScroll_data()
+{
+    addColumnsData();
+}
+
+void ColumnViewBenchmark::benchmarkScroll()
+{
+    QFETCH(int, columns);
+    populate(columns);
+
+    // Scrolling through the whole content, a quarter of column at a time
+    const qreal step = m_view->property("columnWidth").toReal() / 4;
+    const qreal end = qMax(0.0, m_view->property("contentWidth").toReal() - m_view->width());
+    int operations = 0;
+    QBENCHMARK {
+        for (qreal x = 0; x <= end; x += step) {
+            m_view->setProperty("contentX", x);
+            layout();
+            ++operations;
+        }
+    }
+
+    report(operations);
+}
+
+QTEST_MAIN(ColumnViewBenchmark)
+
+#include "columnviewbenchmark.moc"
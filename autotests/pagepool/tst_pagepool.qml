@@ -36,9 +36,45 @@ TestCase {
         id: pool
     }
 
+    Kirigami.PagePool {
+        id: boundedPool
+        maximumPages: 2
+    }
+
+    SignalSpy {
+        id: aboutToBeEvictedSpy
+        target: boundedPool
+        signalName: "pageAboutToBeEvicted"
+    }
+
+    SignalSpy {
+        id: evictedSpy
+        target: boundedPool
+        signalName: "pageEvicted"
+    }
+
+    Kirigami.PagePool {
+        id: asyncPool
+        asynchronous: true
+    }
+
+    SignalSpy {
+        id: warmedUpSpy
+        target: pool
+        signalName: "pageWarmedUp"
+    }
+
     function init() {
         mainWindow.pageStack.clear()
         pool.clear()
+        // Some tests change the limits of boundedPool
+        boundedPool.maximumPages = 2
+        boundedPool.maximumCost = 0
+        boundedPool.clear()
+        aboutToBeEvictedSpy.clear()
+        evictedSpy.clear()
+        warmedUpSpy.clear()
+        asyncPool.clear()
     }
 
     // Queries added to page URLs ensure the PagePool can
@@ -112,4 +148,79 @@ TestCase {
         loadPageActionPropDoesNotExist.trigger()
         verify(pool.lastLoadedUrl.toString().endsWith(expectedUrl))
     }
+
+    function test_evictLeastRecentlyLoaded() {
+        mainWindow.pageStack.push(boundedPool.loadPage("TestPage.qml?page=first"))
+        boundedPool.loadPage("TestPage.qml?page=second")
+        boundedPool.loadPage("TestPage.qml?page=third")
+
+        // The first page is in the page row, so the second one goes
+        evictedSpy.wait()
+        compare(aboutToBeEvictedSpy.count, 1)
+        compare(evictedSpy.count, 1)
+        verify(evictedSpy.signalArguments[0][0].toString().endsWith("TestPage.qml?page=second"))
+        verify(boundedPool.contains("TestPage.qml?page=first"))
+        verify(!boundedPool.contains("TestPage.qml?page=second"))
+        verify(boundedPool.contains("TestPage.qml?page=third"))
+    }
+
+    function test_evictOnlyOverCost() {
+        boundedPool.maximumPages = 0
+        boundedPool.loadPage("TestPage.qml?page=first")
+        boundedPool.loadPage("TestPage.qml?page=second")
+        verify(boundedPool.pageCost("TestPage.qml?page=first") > 0)
+
+        boundedPool.setPageCost("TestPage.qml?page=first", 1000)
+        boundedPool.setPageCost("TestPage.qml?page=second", 1000)
+        boundedPool.maximumCost = 1500
+
+        evictedSpy.wait()
+        verify(evictedSpy.signalArguments[0][0].toString().endsWith("TestPage.qml?page=first"))
+        verify(boundedPool.contains("TestPage.qml?page=second"))
+    }
+
+    function test_warmUp() {
+        pool.warmUp(["TestPage.qml?page=compiled", "TestPage.qml?page=created"], false)
+        pool.warmUp(["TestPage.qml?page=created"], true)
+
+        tryCompare(warmedUpSpy, "count", 2)
+        verify(!pool.contains("TestPage.qml?page=compiled"))
+        verify(pool.contains("TestPage.qml?page=created"))
+
+        // The created page is the one loadPage() gives back
+        var page = pool.pageForUrl("TestPage.qml?page=created")
+        compare(pool.loadPage("TestPage.qml?page=created"), page)
+        compare(pool.loadPage("TestPage.qml?page=compiled").title, "INITIAL TITLE")
+    }
+
+    function test_loadPageDuringWarmUp() {
+        pool.warmUp(["TestPage.qml?page=pending", "TestPage.qml?page=next"], false)
+        // Lets the warm up start compiling the first page
+        wait(0)
+
+        // Called back once the page is compiled, along with the warm up
+        var loaded = null
+        pool.loadPage("TestPage.qml?page=pending", function(item) {
+            loaded = item
+        })
+        tryVerify(function() { return loaded !== null })
+        compare(loaded.title, "INITIAL TITLE")
+
+        // While the warm up goes on
+        tryCompare(warmedUpSpy, "count", 2)
+    }
+
+    function test_loadPageAsynchronously() {
+        var loaded = null
+        var page = asyncPool.loadPageWithProperties("TestPage.qml?page=async", {title: "ASYNC TITLE"}, function(item) {
+            loaded = item
+        })
+        compare(page, null)
+
+        tryVerify(function() { return loaded !== null })
+        compare(loaded.title, "ASYNC TITLE")
+        compare(asyncPool.lastLoadedItem, loaded)
+        verify(asyncPool.lastLoadedUrl.toString().endsWith("TestPage.qml?page=async"))
+        compare(asyncPool.pageForUrl("TestPage.qml?page=async"), loaded)
+    }
 }
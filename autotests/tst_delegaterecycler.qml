@@ -0,0 +1,277 @@
+/*
+ *  SPDX-FileCopyrightText: 2020 The KDE Community
+ *
+ *  SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+import QtQuick 2.7
+import QtTest 1.0
+import org.kde.kirigami 2.15 as Kirigami
+
+TestCase {
+    id: testCase
+    name: "DelegateRecycler"
+    width: 400
+    height: 400
+    visible: true
+    when: windowShown
+
+    property int initialBudget
+
+    Component {
+        id: heavyDelegate
+        Rectangle {
+            property int pooledCount: 0
+            property int reusedCount: 0
+            implicitWidth: 100
+            implicitHeight: 40
+            Text {
+                text: "Delegate"
+            }
+            Rectangle {
+                width: 10
+                height: 10
+            }
+            Kirigami.DelegateRecycler.onPooled: ++pooledCount
+            Kirigami.DelegateRecycler.onReused: ++reusedCount
+        }
+    }
+
+    Component {
+        id: prewarmedDelegate
+        Item {
+            property string title: model.title || ""
+            property int row: index
+            implicitWidth: 100
+            implicitHeight: 20
+        }
+    }
+
+    Component {
+        id: prewarmedListComponent
+        ListView {
+            width: 100
+            height: 20
+            model: ListModel {
+                ListElement {
+                    title: "First"
+                }
+            }
+            delegate: Kirigami.DelegateRecycler {
+                width: 100
+                sourceComponent: prewarmedDelegate
+            }
+        }
+    }
+
+    Component {
+        id: asyncDelegate
+        Rectangle {
+            implicitWidth: 100
+            implicitHeight: 30
+        }
+    }
+
+    Component {
+        id: asyncRecyclerComponent
+        Kirigami.DelegateRecycler {
+            width: 100
+            asynchronous: true
+            sourceComponent: asyncDelegate
+        }
+    }
+
+    Component {
+        id: rowDelegate
+        Item {
+            property int row: index
+            property string rowTitle: title
+            property string rowSubtitle: countEvaluation(subtitle)
+            property int subtitleEvaluations: 0
+            implicitWidth: 100
+            implicitHeight: 20
+
+            function countEvaluation(value) {
+                ++subtitleEvaluations
+                return value
+            }
+        }
+    }
+
+    Component {
+        id: rowListComponent
+        ListView {
+            width: 100
+            height: 100
+            model: ListModel {
+                ListElement {
+                    title: "First"
+                    subtitle: "1"
+                }
+                ListElement {
+                    title: "Second"
+                    subtitle: "2"
+                }
+            }
+            delegate: Kirigami.DelegateRecycler {
+                width: 100
+                sourceComponent: rowDelegate
+            }
+        }
+    }
+
+    Component {
+        id: recyclerComponent
+        Kirigami.DelegateRecycler {
+            width: 100
+            sourceComponent: heavyDelegate
+        }
+    }
+
+    function initTestCase() {
+        initialBudget = Kirigami.DelegateRecyclerCache.memoryBudget
+    }
+
+    function cleanup() {
+        Kirigami.DelegateRecyclerCache.memoryBudget = initialBudget
+    }
+
+    // A pool only lives as long as a DelegateRecycler uses its component,
+    // the tests keep one around so the others can give their delegate back
+    function createKeeper() {
+        return createTemporaryObject(recyclerComponent, testCase)
+    }
+
+    function destroyNow(object) {
+        object.destroy()
+        wait(0)
+    }
+
+    function test_reuse() {
+        createKeeper()
+        var first = recyclerComponent.createObject(testCase)
+        var item = first.children[0]
+        verify(item)
+        compare(item.implicitHeight, 40)
+        compare(first.implicitHeight, 40)
+
+        var before = Kirigami.DelegateRecyclerCache.statistics()
+        destroyNow(first)
+        var pooled = Kirigami.DelegateRecyclerCache.statistics()
+        compare(item.pooledCount, 1)
+        compare(pooled.pooledItems, before.pooledItems + 1)
+        verify(pooled.pooledBytes > before.pooledBytes)
+
+        var second = createTemporaryObject(recyclerComponent, testCase)
+        var after = Kirigami.DelegateRecyclerCache.statistics()
+        compare(second.children[0], item)
+        compare(item.reusedCount, 1)
+        compare(after.hits, before.hits + 1)
+        compare(after.misses, before.misses)
+        compare(after.pooledItems, before.pooledItems)
+        compare(after.pooledBytes, before.pooledBytes)
+    }
+
+    function test_budgetEviction() {
+        createKeeper()
+        var first = recyclerComponent.createObject(testCase)
+        var second = recyclerComponent.createObject(testCase)
+
+        // Lowering the budget drops what is already pooled
+        var before = Kirigami.DelegateRecyclerCache.statistics()
+        destroyNow(first)
+        compare(Kirigami.DelegateRecyclerCache.statistics().pooledItems, before.pooledItems + 1)
+        Kirigami.DelegateRecyclerCache.memoryBudget = 0
+        var dropped = Kirigami.DelegateRecyclerCache.statistics()
+        compare(dropped.evictions, before.evictions + 1)
+        compare(dropped.pooledItems, before.pooledItems)
+        compare(dropped.pooledBytes, before.pooledBytes)
+
+        // With no budget left, nothing is pooled anymore
+        destroyNow(second)
+        var evicted = Kirigami.DelegateRecyclerCache.statistics()
+        compare(evicted.evictions, dropped.evictions + 1)
+        compare(evicted.pooledItems, dropped.pooledItems)
+
+        // So the next delegate has to be created
+        createTemporaryObject(recyclerComponent, testCase)
+        var after = Kirigami.DelegateRecyclerCache.statistics()
+        compare(after.misses, evicted.misses + 1)
+        compare(after.hits, evicted.hits)
+    }
+
+    function test_prewarm() {
+        var before = Kirigami.DelegateRecyclerCache.statistics()
+        Kirigami.DelegateRecyclerCache.prewarm(prewarmedDelegate, 3)
+        // Created in the idle time between frames, not right away
+        compare(Kirigami.DelegateRecyclerCache.statistics().pooledItems, before.pooledItems)
+        tryVerify(function() {
+            return Kirigami.DelegateRecyclerCache.statistics().pooledItems === before.pooledItems + 3
+        })
+
+        var warmed = Kirigami.DelegateRecyclerCache.statistics()
+        var list = createTemporaryObject(prewarmedListComponent, testCase)
+        var after = Kirigami.DelegateRecyclerCache.statistics()
+        compare(after.hits, warmed.hits + 1)
+        compare(after.misses, warmed.misses)
+        compare(after.pooledItems, warmed.pooledItems - 1)
+
+        // Once taken, the delegate shows its row
+        verify(list.currentItem)
+        var item = list.currentItem.children[0]
+        verify(item)
+        compare(item.title, "First")
+        compare(item.row, 0)
+    }
+
+    function test_asynchronous() {
+        // Nothing to hold the place of the first delegate with yet, it's created at once
+        var first = createTemporaryObject(asyncRecyclerComponent, testCase)
+        compare(first.children.length, 1)
+        compare(first.implicitHeight, 30)
+
+        // The next ones have the size of the first one until they are ready
+        var second = createTemporaryObject(asyncRecyclerComponent, testCase)
+        compare(second.children.length, 0)
+        compare(second.implicitHeight, 30)
+        tryVerify(function() { return second.children.length === 1 })
+
+        // Given up on when the DelegateRecycler goes away first
+        var third = asyncRecyclerComponent.createObject(testCase)
+        compare(third.children.length, 0)
+        destroyNow(third)
+        wait(50)
+    }
+
+    function test_trackedProperties() {
+        var list = createTemporaryObject(rowListComponent, testCase)
+        list.currentIndex = 1
+        var item = list.currentItem.children[0]
+        verify(item)
+        compare(item.row, 1)
+        compare(item.rowTitle, "Second")
+
+        // The delegate follows its row when other rows come before it
+        list.model.insert(0, {"title": "Zeroth", "subtitle": "0"})
+        tryCompare(item, "row", 2)
+        compare(item.rowTitle, "Second")
+    }
+
+    function test_roleUpdates() {
+        var list = createTemporaryObject(rowListComponent, testCase)
+        var item = list.currentItem.children[0]
+        verify(item)
+        compare(item.rowTitle, "First")
+        compare(item.rowSubtitle, "1")
+
+        // Only the bindings on the changed role are evaluated again
+        var evaluations = item.subtitleEvaluations
+        list.model.setProperty(0, "title", "Renamed")
+        tryCompare(item, "rowTitle", "Renamed")
+        compare(item.subtitleEvaluations, evaluations)
+
+        list.model.setProperty(0, "subtitle", "One")
+        tryCompare(item, "rowSubtitle", "One")
+        compare(item.subtitleEvaluations, evaluations + 1)
+    }
+}
@@ -13,6 +13,7 @@ HEADERS     += $$PWD/src/kirigamiplugin.h \
                $$PWD/src/libkirigami/kirigamipluginfactory.h \
                $$PWD/src/libkirigami/tabletmodewatcher.h \
                $$PWD/src/scenegraph/managedtexturenode.h \
+               $$PWD/src/scenegraph/textureatlas.h \
                $$PWD/src/scenegraph/paintedrectangleitem.h \
                $$PWD/src/scenegraph/shadowedrectanglenode.h \
                $$PWD/src/scenegraph/shadowedborderrectanglematerial.h \
@@ -22,6 +23,7 @@ HEADERS     += $$PWD/src/kirigamiplugin.h \
                $$PWD/src/scenegraph/shadowedtexturenode.h \
                $$PWD/src/icon.h \
                $$PWD/src/imagecolors.h \
+               $$PWD/src/imagecolorsmodel.h \
                $$PWD/src/delegaterecycler.h \
                $$PWD/src/wheelhandler.h \
                $$PWD/src/shadowedrectangle.h \
@@ -44,6 +46,7 @@ SOURCES     += $$PWD/src/kirigamiplugin.cpp \
                $$PWD/src/libkirigami/kirigamipluginfactory.cpp \
                $$PWD/src/libkirigami/tabletmodewatcher.cpp \
                $$PWD/src/scenegraph/managedtexturenode.cpp \
+               $$PWD/src/scenegraph/textureatlas.cpp \
                $$PWD/src/scenegraph/paintedrectangleitem.cpp \
                $$PWD/src/scenegraph/shadowedrectanglenode.cpp \
                $$PWD/src/scenegraph/shadowedborderrectanglematerial.cpp \
@@ -53,6 +56,7 @@ SOURCES     += $$PWD/src/kirigamiplugin.cpp \
                $$PWD/src/scenegraph/shadowedtexturenode.cpp \
                $$PWD/src/icon.cpp \
                $$PWD/src/imagecolors.cpp \
+               $$PWD/src/imagecolorsmodel.cpp \
                $$PWD/src/delegaterecycler.cpp \
                $$PWD/src/wheelhandler.cpp \
                $$PWD/src/shadowedrectangle.cpp \
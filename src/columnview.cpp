@@ -7,14 +7,26 @@
 #include "columnview.h"
 #include "columnview_p.h"
 
+#include "colorutils.h"
+#include "libkirigami/platformtheme.h"
+
 #include <QAbstractItemModel>
 #include <QGuiApplication>
 #include <QStyleHints>
 #include <QQmlComponent>
 #include <QQmlContext>
 #include <QQmlEngine>
+#include <QQmlProperty>
+#include <QQuickWindow>
 #include <QDebug>
 #include <QPropertyAnimation>
+#include <QSGGeometryNode>
+#include <QSGRectangleNode>
+#include <QSGRendererInterface>
+#include <QSGVertexColorMaterial>
+
+#include <algorithm>
+#include <cmath>
 
 
 QHash<QObject *, ColumnViewAttached *> ColumnView::m_attachedObjects = QHash<QObject *, ColumnViewAttached *>();
@@ -64,22 +76,6 @@ import org.kde.kirigami 2.7 as Kirigami
 QtObject {
     id: root
     readonly property Kirigami.Units units: Kirigami.Units
-
-    readonly property Component separator: Kirigami.Separator {
-        property Item column
-
-        visible: column.Kirigami.ColumnView.view && column.Kirigami.ColumnView.view.contentX < column.x
-        anchors.top: column.top
-        anchors.bottom: column.bottom
-    }
-
-    readonly property Component rightSeparator: Kirigami.Separator {
-        property Item column
-
-        anchors.top: column.top
-        anchors.right: column.right
-        anchors.bottom: column.bottom
-    }
 }
 )"), QUrl(QStringLiteral("columnview.cpp")));
 
@@ -87,12 +83,6 @@ QtObject {
     //qWarning()<<component->errors();
     Q_ASSERT(m_instance);
 
-    m_separatorComponent = m_instance->property("separator").value<QQmlComponent *>();
-    Q_ASSERT(m_separatorComponent);
-
-    m_rightSeparatorComponent = m_instance->property("rightSeparator").value<QQmlComponent *>();
-    Q_ASSERT(m_rightSeparatorComponent);
-
     m_units = m_instance->property("units").value<QObject *>();
     Q_ASSERT(m_units);
 
@@ -103,6 +93,86 @@ QtObject {
 QmlComponentsPool::~QmlComponentsPool()
 {}
 
+static void setInitialProperties(QObject *object, const QVariantMap &properties, QQmlContext *context)
+{
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it) {
+        QQmlProperty property(object, it.key(), context);
+        if (!property.isValid() || !property.write(it.value())) {
+            qWarning() << "ColumnView: could not set property" << it.key();
+        }
+    }
+}
+
+// Hibernated columns can outlive the objects passed as their initial properties:
+// those are kept as guarded pointers, which become null rather than dangling
+static QVariant guardObjects(const QVariant &value)
+{
+    if (QMetaType::typeFlags(value.userType()) & QMetaType::PointerToQObject) {
+        return QVariant::fromValue(QPointer<QObject>(value.value<QObject *>()));
+    } else if (value.userType() == QMetaType::QVariantList) {
+        QVariantList list = value.toList();
+        for (QVariant &item : list) {
+            item = guardObjects(item);
+        }
+        return list;
+    } else if (value.userType() == QMetaType::QVariantMap) {
+        QVariantMap map = value.toMap();
+        for (QVariant &item : map) {
+            item = guardObjects(item);
+        }
+        return map;
+    }
+    return value;
+}
+
+static QVariant unguardObjects(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<QPointer<QObject>>()) {
+        return QVariant::fromValue<QObject *>(value.value<QPointer<QObject>>().data());
+    } else if (value.userType() == QMetaType::QVariantList) {
+        QVariantList list = value.toList();
+        for (QVariant &item : list) {
+            item = unguardObjects(item);
+        }
+        return list;
+    } else if (value.userType() == QMetaType::QVariantMap) {
+        QVariantMap map = value.toMap();
+        for (QVariant &item : map) {
+            item = unguardObjects(item);
+        }
+        return map;
+    }
+    return value;
+}
+
+ColumnIncubator::ColumnIncubator(const QVariantMap &properties, QQmlContext *context, std::function<void(QQuickItem *)> callback)
+    : QQmlIncubator(QQmlIncubator::Asynchronous)
+    , m_properties(properties)
+    , m_context(context)
+    , m_callback(callback)
+{
+}
+
+void ColumnIncubator::setInitialState(QObject *object)
+{
+    // Objects can go away while the column gets created
+    setInitialProperties(object, unguardObjects(m_properties).toMap(), m_context);
+}
+
+void ColumnIncubator::statusChanged(QQmlIncubator::Status status)
+{
+    if (status == QQmlIncubator::Error) {
+        qWarning() << "Could not restore hibernated column" << errors();
+        m_callback(nullptr);
+    } else if (status == QQmlIncubator::Ready) {
+        QQuickItem *item = qobject_cast<QQuickItem *>(object());
+        if (!item) {
+            delete object();
+        }
+        m_callback(item);
+    }
+}
+
 
 /////////
 
@@ -273,7 +343,187 @@ void ColumnViewAttached::setPinned(bool pinned)
     }
 }
 
+QQmlComponent *ColumnViewAttached::component() const
+{
+    return m_component;
+}
+
+QVariantMap ColumnViewAttached::initialProperties() const
+{
+    return unguardObjects(m_initialProperties).toMap();
+}
+
+void ColumnViewAttached::setComponent(QQmlComponent *component, const QVariantMap &properties)
+{
+    m_component = component;
+    m_initialProperties = guardObjects(properties).toMap();
+}
+
+bool ColumnViewAttached::isHibernated() const
+{
+    return m_hibernated;
+}
+
+void ColumnViewAttached::setHibernated(bool hibernated)
+{
+    if (hibernated == m_hibernated) {
+        return;
+    }
+
+    m_hibernated = hibernated;
+    emit hibernatedChanged();
+}
+
+
+
+/////////
+
+ColumnSeparators::ColumnSeparators(ContentItem *contentItem, QQuickItem *parent)
+    : QQuickItem(parent)
+    , m_contentItem(contentItem)
+{
+    setFlag(ItemHasContents);
+}
+
+void ColumnSeparators::forgetColor(QQuickItem *column)
+{
+    m_colors.remove(column);
+    polish();
+}
+
+QColor ColumnSeparators::separatorColor(QQuickItem *column)
+{
+    auto it = m_colors.constFind(column);
+    if (it != m_colors.constEnd()) {
+        return it.value();
+    }
+
+    // Same as Kirigami.Separator
+    Kirigami::PlatformTheme *theme = qobject_cast<Kirigami::PlatformTheme *>(qmlAttachedPropertiesObject<Kirigami::PlatformTheme>(column, true));
+    const QColor color = ColorUtils().linearInterpolation(theme->backgroundColor(), theme->textColor(), 0.15);
+    m_colors.insert(column, color);
+    return color;
+}
+
+void ColumnSeparators::updatePolish()
+{
+    m_separators.clear();
+
+    ColumnView *view = m_contentItem->m_view;
+    if (view->separatorVisible()) {
+        const qreal width = m_contentItem->separatorWidth();
+        const QPointF offset = m_contentItem->position();
+        const bool canPin = view->columnResizeMode() != ColumnView::SingleColumn;
+
+        QVector<QRectF> pinnedColumns;
+        if (canPin) {
+            for (QObject *object : qAsConst(m_contentItem->m_visibleItems)) {
+                QQuickItem *column = static_cast<QQuickItem *>(object);
+                if (m_contentItem->attachedFor(column)->isPinned()) {
+                    pinnedColumns << QRectF(column->position() + offset, column->size());
+                }
+            }
+        }
+
+        for (QObject *object : qAsConst(m_contentItem->m_visibleItems)) {
+            QQuickItem *column = static_cast<QQuickItem *>(object);
+            if (column->x() + offset.x() >= view->width()) {
+                continue;
+            }
 
+            const bool pinned = canPin && m_contentItem->attachedFor(column)->isPinned();
+
+            // Every column but the one at the beginning of the view has a separator on its left
+            if (column->x() > -m_contentItem->x()) {
+                const QRectF rect(column->x() + offset.x(), column->y() + offset.y(), width, column->height());
+                // Pinned columns are on top of the others and of their separators
+                const bool covered = !pinned && std::any_of(pinnedColumns.constBegin(), pinnedColumns.constEnd(), [&rect](const QRectF &pinnedColumn) {
+                    return pinnedColumn.intersects(rect);
+                });
+                if (!covered) {
+                    m_separators << Separator{rect, separatorColor(column)};
+                }
+            }
+
+            if (pinned) {
+                const QRectF rect(column->x() + column->width() - width + offset.x(), column->y() + offset.y(), width, column->height());
+                m_separators << Separator{rect, separatorColor(column)};
+            }
+        }
+    }
+
+    update();
+}
+
+QSGNode *ColumnSeparators::updatePaintNode(QSGNode *node, QQuickItem::UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+
+    if (m_separators.isEmpty()) {
+        delete node;
+        return nullptr;
+    }
+
+    // The software renderer can only draw rectangle nodes
+    if (window()->rendererInterface()->graphicsApi() == QSGRendererInterface::Software) {
+        if (!node) {
+            node = new QSGNode;
+        }
+        while (node->childCount() > m_separators.count()) {
+            QSGNode *child = node->lastChild();
+            node->removeChildNode(child);
+            delete child;
+        }
+        while (node->childCount() < m_separators.count()) {
+            node->appendChildNode(window()->createRectangleNode());
+        }
+
+        QSGNode *child = node->firstChild();
+        for (const Separator &separator : qAsConst(m_separators)) {
+            QSGRectangleNode *rectangle = static_cast<QSGRectangleNode *>(child);
+            rectangle->setRect(separator.rect);
+            rectangle->setColor(separator.color);
+            child = child->nextSibling();
+        }
+        return node;
+    }
+
+    QSGGeometryNode *geometryNode = static_cast<QSGGeometryNode *>(node);
+    if (!geometryNode) {
+        geometryNode = new QSGGeometryNode;
+        QSGGeometry *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_ColoredPoint2D(), 0);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        geometryNode->setGeometry(geometry);
+        geometryNode->setFlag(QSGNode::OwnsGeometry);
+        geometryNode->setMaterial(new QSGVertexColorMaterial);
+        geometryNode->setFlag(QSGNode::OwnsMaterial);
+    }
+
+    // Two triangles per separator
+    QSGGeometry *geometry = geometryNode->geometry();
+    geometry->allocate(m_separators.count() * 6);
+    QSGGeometry::ColoredPoint2D *vertex = geometry->vertexDataAsColoredPoint2D();
+    for (const Separator &separator : qAsConst(m_separators)) {
+        // The material wants premultiplied colors
+        const QRgb color = qPremultiply(separator.color.rgba());
+        const uchar r = qRed(color);
+        const uchar g = qGreen(color);
+        const uchar b = qBlue(color);
+        const uchar a = qAlpha(color);
+        const QRectF &rect = separator.rect;
+
+        vertex[0].set(rect.left(), rect.top(), r, g, b, a);
+        vertex[1].set(rect.right(), rect.top(), r, g, b, a);
+        vertex[2].set(rect.left(), rect.bottom(), r, g, b, a);
+        vertex[3].set(rect.right(), rect.top(), r, g, b, a);
+        vertex[4].set(rect.right(), rect.bottom(), r, g, b, a);
+        vertex[5].set(rect.left(), rect.bottom(), r, g, b, a);
+        vertex += 6;
+    }
+    geometryNode->markDirty(QSGNode::DirtyGeometry);
+
+    return geometryNode;
+}
 
 /////////
 
@@ -282,6 +532,9 @@ ContentItem::ContentItem(ColumnView *parent)
       m_view(parent)
 {
     setFlags(flags() | ItemIsFocusScope);
+    // Created after this, to be on top of it. The view doesn't take it as a column
+    // as the view doesn't know its content item yet
+    m_separatorsItem = new ColumnSeparators(this, parent);
     m_slideAnim = new QPropertyAnimation(this);
     m_slideAnim->setTargetObject(this);
     m_slideAnim->setPropertyName("x");
@@ -303,7 +556,9 @@ ContentItem::ContentItem(ColumnView *parent)
 }
 
 ContentItem::~ContentItem()
-{}
+{
+    qDeleteAll(m_incubators);
+}
 
 void ContentItem::setBoundedX(qreal x)
 {
@@ -366,14 +621,38 @@ qreal ContentItem::viewportRight() const
     return -x() + m_view->width() - m_rightPinnedSpace;
 }
 
+ColumnViewAttached *ContentItem::attachedFor(QQuickItem *item)
+{
+    ColumnViewAttached *&attached = m_attachedObjects[item];
+    if (!attached) {
+        attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(item, true));
+    }
+    return attached;
+}
+
+QQuickItem *ContentItem::itemAtLayoutPosition(int position) const
+{
+    return m_layoutReverse ? m_items[m_items.count() - 1 - position] : m_items[position];
+}
+
+void ContentItem::invalidateLayout(int index)
+{
+    // Right to left layouts are always done from scratch
+    m_layoutFrom = qMin(m_layoutFrom, qMax(0, index));
+    m_view->polish();
+}
+
 qreal ContentItem::childWidth(QQuickItem *child)
+{
+    return childWidth(child, attachedFor(child));
+}
+
+qreal ContentItem::childWidth(QQuickItem *child, ColumnViewAttached *attached)
 {
     if (!parentItem()) {
         return 0.0;
     }
 
-    ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(child, true));
-
     if (m_columnResizeMode == ColumnView::SingleColumn) {
         return qRound(parentItem()->width());
 
@@ -401,72 +680,74 @@ void ContentItem::layoutItems()
     setY(m_view->topPadding());
     setHeight(m_view->height() - m_view->topPadding() - m_view->bottomPadding());
 
-    qreal implicitWidth = 0;
-    qreal implicitHeight = 0;
-    qreal partialWidth = 0;
-    int i = 0;
-    m_leftPinnedSpace = 0;
-    m_rightPinnedSpace = 0;
-
-    bool reverse = qApp->layoutDirection() == Qt::RightToLeft;
-    auto it = !reverse ? m_items.begin() : m_items.end();
-    int increment = reverse ? -1 : +1;
-    auto lastPos = reverse ? m_items.begin() : m_items.end();
-
-    for (; it != lastPos; it += increment) {
-    //for (QQuickItem *child : qAsConst(m_items)) {
-        QQuickItem *child = reverse ? *(it - 1) : *it;
-        ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(child, true));
-
+    const bool reverse = qApp->layoutDirection() == Qt::RightToLeft;
+    const int count = m_items.count();
+
+    // Anything every column depends on needs all of them to be laid out again,
+    // otherwise only the ones after the first that changed
+    if (reverse || reverse != m_layoutReverse
+        || !qFuzzyCompare(height(), m_layoutHeight)
+        || !qFuzzyCompare(m_view->width(), m_layoutViewWidth)
+        || !qFuzzyCompare(m_columnWidth, m_layoutColumnWidth)
+        || m_columnResizeMode != m_layoutResizeMode
+        || m_view->separatorVisible() != m_layoutSeparatorVisible) {
+        m_layoutFrom = 0;
+    }
+    const int from = qBound(0, m_layoutFrom, qMin(count, m_columnOffsets.count() - 1));
+
+    m_layoutReverse = reverse;
+    m_layoutHeight = height();
+    m_layoutViewWidth = m_view->width();
+    m_layoutColumnWidth = m_columnWidth;
+    m_layoutResizeMode = m_columnResizeMode;
+    m_layoutSeparatorVisible = m_view->separatorVisible();
+
+    m_columnOffsets.resize(count + 1);
+    m_implicitWidths.resize(count + 1);
+    m_implicitHeights.resize(count + 1);
+    while (!m_pinnedPositions.isEmpty() && m_pinnedPositions.last() >= from) {
+        m_pinnedPositions.removeLast();
+    }
+
+    // Changes happening while laying out are caught by the next pass
+    m_layoutFrom = count;
+    m_layouting = true;
+
+    for (int position = from; position < count; ++position) {
+        QQuickItem *child = itemAtLayoutPosition(position);
+        ColumnViewAttached *attached = attachedFor(child);
+        attached->setIndex(reverse ? count - 1 - position : position);
+
+        qreal width = 0;
         if (child->isVisible()) {
-            if (attached->isPinned() && m_view->columnResizeMode() != ColumnView::SingleColumn) {
-                QQuickItem *sep = nullptr;
-                int sepWidth = 0;
-                if (m_view->separatorVisible()) {
-                    sep = ensureRightSeparator(child);
-                    sepWidth = (sep ? sep->width() : 0);
-                }
-                const qreal width = childWidth(child);
+            if (attached->isPinned() && m_columnResizeMode != ColumnView::SingleColumn) {
+                // Positioned by layoutPinnedItems()
+                const qreal sepWidth = m_view->separatorVisible() ? separatorWidth() : 0;
+                width = childWidth(child, attached);
                 child->setSize(QSizeF(width + sepWidth, height()));
-
-                child->setPosition(QPointF(qMin(qMax(-x(), partialWidth), -x() + m_view->width() - child->width() + sepWidth), 0.0));
                 child->setZ(1);
-
-                if (partialWidth <= -x()) {
-                    m_leftPinnedSpace = qMax(m_leftPinnedSpace, width);
-                } else if (partialWidth > -x() + m_view->width() - child->width() + sepWidth) {
-                    m_rightPinnedSpace = qMax(m_rightPinnedSpace, child->width());
-                }
-
-                partialWidth += width;
+                m_pinnedPositions << position;
 
             } else {
-                child->setSize(QSizeF(childWidth(child), height()));
-
-                auto it = m_rightSeparators.find(child);
-                if (it != m_rightSeparators.end()) {
-                    it.value()->deleteLater();
-                    m_rightSeparators.erase(it);
-                }
-                child->setPosition(QPointF(partialWidth, 0.0));
+                child->setSize(QSizeF(childWidth(child, attached), height()));
+                child->setPosition(QPointF(m_columnOffsets[position], 0.0));
                 child->setZ(0);
 
-                partialWidth += child->width();
+                width = child->width();
             }
         }
 
-        if (reverse) {
-            attached->setIndex(m_items.count() - (++i));
-        } else {
-            attached->setIndex(i++);
-        }
+        m_columnOffsets[position + 1] = m_columnOffsets[position] + width;
+        m_implicitWidths[position + 1] = m_implicitWidths[position] + child->implicitWidth();
+        m_implicitHeights[position + 1] = qMax(m_implicitHeights[position], child->implicitHeight());
+    }
 
-        implicitWidth += child->implicitWidth();
+    m_layouting = false;
 
-        implicitHeight = qMax(implicitHeight, child->implicitHeight());
-    }
+    const qreal implicitWidth = m_implicitWidths[count];
+    const qreal implicitHeight = m_implicitHeights[count];
 
-    setWidth(partialWidth);
+    setWidth(m_columnOffsets[count]);
 
     setImplicitWidth(implicitWidth);
     setImplicitHeight(implicitHeight);
@@ -474,6 +755,8 @@ void ContentItem::layoutItems()
     m_view->setImplicitWidth(implicitWidth);
     m_view->setImplicitHeight(implicitHeight + m_view->topPadding() + m_view->bottomPadding());
 
+    layoutPinnedItems();
+
     const qreal newContentX = m_viewAnchorItem ? -m_viewAnchorItem->x() : 0.0;
     if (m_shouldAnimate) {
         animateX(newContentX);
@@ -482,6 +765,12 @@ void ContentItem::layoutItems()
     }
 
     updateVisibleItems();
+
+    if (m_layoutFrom < count) {
+        m_view->polish();
+    }
+
+    emit itemsLaidOut();
 }
 
 void ContentItem::layoutPinnedItems()
@@ -490,49 +779,86 @@ void ContentItem::layoutPinnedItems()
         return;
     }
 
-    qreal partialWidth = 0;
     m_leftPinnedSpace = 0;
     m_rightPinnedSpace = 0;
 
-    for (QQuickItem *child : qAsConst(m_items)) {
-        ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(child, true));
-
-        if (child->isVisible()) {
-            if (attached->isPinned()) {
-                QQuickItem *sep = nullptr;
-                int sepWidth = 0;
-                if (m_view->separatorVisible()) {
-                    sep = ensureRightSeparator(child);
-                    sepWidth = (sep ? sep->width() : 0);
-                }
+    for (int position : qAsConst(m_pinnedPositions)) {
+        // Items removed since the last layout
+        if (position >= m_items.count()) {
+            break;
+        }
 
-                child->setPosition(QPointF(qMin(qMax(-x(), partialWidth), -x() + m_view->width() - child->width() + sepWidth), 0.0));
+        QQuickItem *child = itemAtLayoutPosition(position);
+        if (!child->isVisible() || !attachedFor(child)->isPinned()) {
+            continue;
+        }
 
-                if (partialWidth <= -x()) {
-                    m_leftPinnedSpace = qMax(m_leftPinnedSpace, child->width() - sepWidth);
-                } else if (partialWidth > -x() + m_view->width() - child->width() + sepWidth) {
-                    m_rightPinnedSpace = qMax(m_rightPinnedSpace, child->width());
-                }
-            }
+        const qreal sepWidth = m_view->separatorVisible() ? separatorWidth() : 0;
+        const qreal partialWidth = m_columnOffsets[position];
+        child->setPosition(QPointF(qMin(qMax(-x(), partialWidth), -x() + m_view->width() - child->width() + sepWidth), 0.0));
 
-            partialWidth += child->width();
+        if (partialWidth <= -x()) {
+            m_leftPinnedSpace = qMax(m_leftPinnedSpace, child->width() - sepWidth);
+        } else if (partialWidth > -x() + m_view->width() - child->width() + sepWidth) {
+            m_rightPinnedSpace = qMax(m_rightPinnedSpace, child->width());
         }
     }
+
+    m_separatorsItem->polish();
 }
 
 void ContentItem::updateVisibleItems()
 {
     QList <QObject *> newItems;
 
-    for (auto *item : qAsConst(m_items)) {
-        if (item->isVisible() && item->x() + x() < width() && item->x() + item->width() + x() > 0) {
-            newItems << item;
-            connect(item, &QObject::destroyed, this, [this, item] {
-                m_visibleItems.removeAll(item);
-            });
+    auto isInViewport = [this](QQuickItem *item) {
+        return item->isVisible() && item->x() + x() < width() && item->x() + item->width() + x() > 0;
+    };
+
+    const int count = m_items.count();
+    if (m_layouting || m_layoutFrom < count || m_columnOffsets.count() != count + 1) {
+        // The layout is out of date, look at the actual geometries
+        for (auto *item : qAsConst(m_items)) {
+            if (isInViewport(item)) {
+                newItems << item;
+            }
+        }
+
+    } else {
+        // Columns which end after the left side of the viewport and start before its right side
+        const auto offsetsBegin = m_columnOffsets.constBegin();
+        const int first = std::upper_bound(offsetsBegin + 1, m_columnOffsets.constEnd(), -x()) - (offsetsBegin + 1);
+        const int last = std::lower_bound(offsetsBegin, m_columnOffsets.constEnd() - 1, width() - x()) - offsetsBegin;
+
+        QVector<int> indexes;
+        for (int position = first; position < last; ++position) {
+            // Pinned columns are not where the offsets say
+            if (std::binary_search(m_pinnedPositions.constBegin(), m_pinnedPositions.constEnd(), position)) {
+                continue;
+            }
+            if (itemAtLayoutPosition(position)->isVisible()) {
+                indexes << (m_layoutReverse ? count - 1 - position : position);
+            }
+        }
+        for (int position : qAsConst(m_pinnedPositions)) {
+            if (isInViewport(itemAtLayoutPosition(position))) {
+                indexes << (m_layoutReverse ? count - 1 - position : position);
+            }
+        }
+        std::sort(indexes.begin(), indexes.end());
+
+        for (int index : qAsConst(indexes)) {
+            newItems << m_items[index];
         }
     }
 
+    for (auto *item : qAsConst(newItems)) {
+        QQuickItem *visibleItem = static_cast<QQuickItem *>(item);
+        connect(visibleItem, &QObject::destroyed, this, [this, visibleItem] {
+            m_visibleItems.removeAll(visibleItem);
+        });
+    }
+
     for (auto *item : qAsConst(m_visibleItems)) {
         disconnect(item, &QObject::destroyed, this, nullptr);
     }
@@ -548,7 +874,13 @@ void ContentItem::updateVisibleItems()
         if (!newItems.isEmpty() && m_visibleItems.last() != oldLastVisibleItem) {
             emit m_view->lastVisibleItemChanged();
         }
+        if (m_hibernationDistance >= 0) {
+            scheduleHibernation();
+        }
     }
+
+    // Separators move with the columns
+    m_separatorsItem->polish();
 }
 
 void ContentItem::forgetItem(QQuickItem *item)
@@ -565,17 +897,13 @@ void ContentItem::forgetItem(QQuickItem *item)
     disconnect(item, nullptr, this, nullptr);
     disconnect(item, nullptr, m_view, nullptr);
 
-    QQuickItem *separatorItem = m_separators.take(item);
-    if (separatorItem) {
-        separatorItem->deleteLater();
-    }
-    separatorItem = m_rightSeparators.take(item);
-    if (separatorItem) {
-        separatorItem->deleteLater();
-    }
+    delete m_incubators.take(item);
+    m_attachedObjects.remove(item);
+    m_separatorsItem->forgetColor(item);
 
     const int index = m_items.indexOf(item);
     m_items.removeAll(item);
+    invalidateLayout(index);
     disconnect(item, &QObject::destroyed, this, nullptr);
     updateVisibleItems();
     m_shouldAnimate = true;
@@ -587,40 +915,225 @@ void ContentItem::forgetItem(QQuickItem *item)
     emit m_view->countChanged();
 }
 
-QQuickItem *ContentItem::ensureSeparator(QQuickItem *item)
+qreal ContentItem::separatorWidth() const
+{
+    QQmlEngine *engine = qmlEngine(m_view);
+    if (!engine) {
+        return 1;
+    }
+    // Same as Kirigami.Separator
+    return qMax(1.0, std::floor(QmlComponentsPoolSingleton::instance(engine)->m_units->property("devicePixelRatio").toReal()));
+}
+
+QQuickItem *ContentItem::createColumn(QQmlComponent *component, const QVariantMap &properties)
+{
+    if (!component || component->status() != QQmlComponent::Ready) {
+        if (component) {
+            qWarning() << component->errors();
+        }
+        return nullptr;
+    }
+
+    QQmlContext *ctx = component->creationContext() ? component->creationContext() : QQmlEngine::contextForObject(m_view);
+    QObject *obj = component->beginCreate(ctx);
+    if (!obj) {
+        return nullptr;
+    }
+    setInitialProperties(obj, properties, ctx);
+    component->completeCreate();
+
+    QQuickItem *item = qobject_cast<QQuickItem *>(obj);
+    if (!item) {
+        qWarning() << "ColumnView: columns must be Items";
+        obj->deleteLater();
+        return nullptr;
+    }
+
+    // Same as Component.createObject, so removeItem() deletes it
+    QQmlEngine::setObjectOwnership(item, QQmlEngine::JavaScriptOwnership);
+    return item;
+}
+
+void ContentItem::scheduleHibernation()
+{
+    if (m_hibernationScheduled) {
+        return;
+    }
+
+    // Not while laying out or removing items, they change m_items
+    m_hibernationScheduled = true;
+    QMetaObject::invokeMethod(this, &ContentItem::updateHibernation, Qt::QueuedConnection);
+}
+
+void ContentItem::updateHibernation()
 {
-    QQuickItem *separatorItem = m_separators.value(item);
+    m_hibernationScheduled = false;
 
-    if (!separatorItem) {
-        separatorItem = qobject_cast<QQuickItem *>(privateQmlComponentsPoolSelf->instance(qmlEngine(item))->m_separatorComponent->beginCreate(QQmlEngine::contextForObject(item)));
-        if (separatorItem) {
-            separatorItem->setParentItem(item);
-            separatorItem->setZ(9999);
-            separatorItem->setProperty("column", QVariant::fromValue(item));
-            QmlComponentsPoolSingleton::instance(qmlEngine(item))->m_separatorComponent->completeCreate();
-            m_separators[item] = separatorItem;
+    if (m_hibernationDistance < 0) {
+        for (int i = 0; i < m_items.count(); ++i) {
+            ColumnViewAttached *attached = attachedFor(m_items[i]);
+            if (attached->isHibernated()) {
+                restoreItem(i);
+            }
         }
+        return;
+    }
+
+    if (m_visibleItems.isEmpty()) {
+        return;
+    }
+
+    const int first = m_items.indexOf(qobject_cast<QQuickItem *>(m_visibleItems.first()));
+    const int last = m_items.indexOf(qobject_cast<QQuickItem *>(m_visibleItems.last()));
+    if (first < 0 || last < 0) {
+        return;
+    }
+
+    for (int i = 0; i < m_items.count(); ++i) {
+        QQuickItem *item = m_items[i];
+        ColumnViewAttached *attached = attachedFor(item);
+        const bool near = i >= qMin(first, last) - m_hibernationDistance && i <= qMax(first, last) + m_hibernationDistance;
+
+        if (attached->isHibernated()) {
+            if (near) {
+                restoreItem(i);
+            }
+        } else if (!near && attached->component() && !attached->isPinned()
+                   && i != m_view->currentIndex() && item != m_viewAnchorItem) {
+            hibernateItem(i);
+        }
+    }
+}
+
+void ContentItem::hibernateItem(int index)
+{
+    QQuickItem *item = m_items[index];
+    ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(item, true));
+
+    // The placeholder takes exactly the same space, so nothing moves.
+    // As a child of the content item, it doesn't outlive the view while still hibernated
+    QQuickItem *placeholder = new QQuickItem();
+    placeholder->setParent(this);
+    QQmlEngine::setObjectOwnership(placeholder, QQmlEngine::CppOwnership);
+    placeholder->setImplicitSize(item->implicitWidth(), item->implicitHeight());
+
+    ColumnViewAttached *placeholderAttached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(placeholder, true));
+    placeholderAttached->setComponent(attached->component(), attached->initialProperties());
+    placeholderAttached->setHibernated(true);
+    if (attached->m_customFillWidth) {
+        placeholderAttached->setFillWidth(attached->fillWidth());
     }
+    if (attached->m_customReservedSpace) {
+        placeholderAttached->setReservedSpace(attached->reservedSpace());
+    }
+    placeholderAttached->setPreventStealing(attached->preventStealing());
 
-    return separatorItem;
+    replaceItem(index, placeholder);
+    emit m_view->itemHibernated(index, item);
+    item->deleteLater();
 }
 
-QQuickItem *ContentItem::ensureRightSeparator(QQuickItem *item)
+void ContentItem::restoreItem(int index)
 {
-    QQuickItem *separatorItem = m_rightSeparators.value(item);
+    QQuickItem *placeholder = m_items[index];
+    ColumnViewAttached *placeholderAttached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(placeholder, true));
+    QQmlComponent *component = placeholderAttached->component();
 
-    if (!separatorItem) {
-        separatorItem = qobject_cast<QQuickItem *>(QmlComponentsPoolSingleton::instance(qmlEngine(item))->m_rightSeparatorComponent->beginCreate(QQmlEngine::contextForObject(item)));
-        if (separatorItem) {
-            separatorItem->setParentItem(item);
-            separatorItem->setZ(9999);
-            separatorItem->setProperty("column", QVariant::fromValue(item));
-            QmlComponentsPoolSingleton::instance(qmlEngine(item))->m_rightSeparatorComponent->completeCreate();
-            m_rightSeparators[item] = separatorItem;
+    // The incubators done with couldn't be deleted from their own callback
+    for (auto it = m_incubators.begin(); it != m_incubators.end();) {
+        if (it.value()->isLoading()) {
+            ++it;
+        } else {
+            delete it.value();
+            it = m_incubators.erase(it);
         }
     }
 
-    return separatorItem;
+    if (!component || m_incubators.contains(placeholder)) {
+        return;
+    }
+
+    const QPointer<QQmlComponent> guardedComponent = component;
+
+    auto restore = [this, placeholder, guardedComponent](QQuickItem *item) {
+        const int index = m_items.indexOf(placeholder);
+        if (index < 0) {
+            item->deleteLater();
+            return;
+        }
+
+        ColumnViewAttached *placeholderAttached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(placeholder, true));
+        ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(item, true));
+        attached->setComponent(guardedComponent, placeholderAttached->initialProperties());
+        if (placeholderAttached->m_customFillWidth) {
+            attached->setFillWidth(placeholderAttached->fillWidth());
+        }
+        if (placeholderAttached->m_customReservedSpace) {
+            attached->setReservedSpace(placeholderAttached->reservedSpace());
+        }
+
+        replaceItem(index, item);
+        emit m_view->itemRestored(index, item);
+        placeholder->deleteLater();
+    };
+
+    if (!m_asynchronousRestore) {
+        QQuickItem *item = createColumn(component, placeholderAttached->initialProperties());
+        if (item) {
+            restore(item);
+        }
+        return;
+    }
+
+    QQmlContext *ctx = component->creationContext() ? component->creationContext() : QQmlEngine::contextForObject(m_view);
+    ColumnIncubator *incubator = new ColumnIncubator(placeholderAttached->m_initialProperties, ctx, [restore](QQuickItem *item) {
+        if (item) {
+            QQmlEngine::setObjectOwnership(item, QQmlEngine::JavaScriptOwnership);
+            restore(item);
+        }
+    });
+    m_incubators[placeholder] = incubator;
+    component->create(*incubator, ctx);
+}
+
+void ContentItem::replaceItem(int index, QQuickItem *item)
+{
+    QQuickItem *oldItem = m_items[index];
+    ColumnViewAttached *oldAttached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(oldItem, true));
+
+    // As the old item is not in m_items anymore, forgetItem() won't touch the view when it's unparented
+    m_items[index] = item;
+    oldAttached->setView(nullptr);
+    oldAttached->setIndex(-1);
+    disconnect(oldAttached, nullptr, this, nullptr);
+    disconnect(oldItem, nullptr, this, nullptr);
+    disconnect(oldItem, nullptr, m_view, nullptr);
+    m_attachedObjects.remove(oldItem);
+    m_separatorsItem->forgetColor(oldItem);
+    m_visibleItems.removeAll(oldItem);
+    oldItem->setVisible(false);
+    oldItem->setParentItem(nullptr);
+
+    connect(item, &QObject::destroyed, this, [this, item]() {
+        m_view->removeItem(item);
+    });
+    ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(item, true));
+    attached->setOriginalParent(nullptr);
+    attached->setShouldDeleteOnRemove(true);
+    item->setParentItem(this);
+    attached->setIndex(index);
+    invalidateLayout(index);
+
+    if (m_viewAnchorItem == oldItem) {
+        m_viewAnchorItem = item;
+    }
+    if (m_view->m_currentItem == oldItem) {
+        m_view->m_currentItem = item;
+        item->forceActiveFocus();
+        emit m_view->currentItemChanged();
+    }
+
+    emit m_view->contentChildrenChanged();
 }
 
 void ContentItem::itemChange(QQuickItem::ItemChange change, const QQuickItem::ItemChangeData &value)
@@ -630,26 +1143,37 @@ void ContentItem::itemChange(QQuickItem::ItemChange change, const QQuickItem::It
         ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(value.item, true));
         attached->setView(m_view);
 
-        //connect(attached, &ColumnViewAttached::fillWidthChanged, m_view, &ColumnView::polish);
-        connect(attached, &ColumnViewAttached::fillWidthChanged, this, [this] {
-             m_view->polish();
+        QQuickItem *item = value.item;
+        auto invalidate = [this, item]() {
+            invalidateLayout(m_items.indexOf(item));
+        };
+        connect(attached, &ColumnViewAttached::fillWidthChanged, this, invalidate);
+        connect(attached, &ColumnViewAttached::reservedSpaceChanged, this, invalidate);
+        connect(attached, &ColumnViewAttached::pinnedChanged, this, invalidate);
+        connect(item, &QQuickItem::visibleChanged, this, invalidate);
+        connect(item, &QQuickItem::implicitWidthChanged, this, invalidate);
+        connect(item, &QQuickItem::implicitHeightChanged, this, invalidate);
+        // The layout itself resizes the columns
+        connect(item, &QQuickItem::widthChanged, this, [this, invalidate]() {
+            if (!m_layouting) {
+                invalidate();
+            }
         });
-        connect(attached, &ColumnViewAttached::reservedSpaceChanged, m_view, &ColumnView::polish);
 
-        value.item->setVisible(true);
+        item->setVisible(true);
 
-        if (!m_items.contains(value.item)) {
-            connect(value.item, &QQuickItem::widthChanged, m_view, &ColumnView::polish);
-            QQuickItem *item = value.item;
+        if (!m_items.contains(item)) {
             m_items << item;
             connect(item, &QObject::destroyed, this, [this, item]() {
                 m_view->removeItem(item);
             });
         }
+        invalidateLayout(m_items.indexOf(item));
 
-        if (m_view->separatorVisible()) {
-            ensureSeparator(value.item);
-        }
+        Kirigami::PlatformTheme *theme = qobject_cast<Kirigami::PlatformTheme *>(qmlAttachedPropertiesObject<Kirigami::PlatformTheme>(item, true));
+        connect(theme, &Kirigami::PlatformTheme::colorsChanged, this, [this, item]() {
+            m_separatorsItem->forgetColor(item);
+        });
 
         m_shouldAnimate = true;
         m_view->polish();
@@ -685,6 +1209,7 @@ void ContentItem::syncItemsOrder()
     }
 
     m_items = childItems();
+    m_layoutFrom = 0;
     //NOTE: polish() here sometimes gets indefinitely delayed and items chaging order isn't seen
     layoutItems();
 }
@@ -949,30 +1474,9 @@ void ColumnView::setSeparatorVisible(bool visible)
 
     m_separatorVisible = visible;
 
-    if (visible) {
-        for (QQuickItem *item : qAsConst(m_contentItem->m_items)) {
-            QQuickItem *sep = m_contentItem->ensureSeparator(item);
-            if (sep) {
-                sep->setVisible(true);
-            }
-
-            ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(item, true));
-            if (attached->isPinned()) {
-                QQuickItem *sep = m_contentItem->ensureRightSeparator(item);
-                if (sep) {
-                    sep->setVisible(true);
-                }
-            }
-        }
-
-    } else {
-        for (QQuickItem *sep : qAsConst(m_contentItem->m_separators)) {
-            sep->setVisible(false);
-        }
-        for (QQuickItem *sep : qAsConst(m_contentItem->m_rightSeparators)) {
-            sep->setVisible(false);
-        }
-    }
+    // Pinned columns are wider with their separator
+    polish();
+    m_contentItem->m_separatorsItem->polish();
 
     emit separatorVisibleChanged();
 }
@@ -1054,6 +1558,39 @@ void ColumnView::setAcceptsMouse(bool accepts)
     emit acceptsMouseChanged();
 }
 
+int ColumnView::hibernationDistance() const
+{
+    return m_contentItem->m_hibernationDistance;
+}
+
+void ColumnView::setHibernationDistance(int distance)
+{
+    distance = qMax(-1, distance);
+    if (m_contentItem->m_hibernationDistance == distance) {
+        return;
+    }
+
+    m_contentItem->m_hibernationDistance = distance;
+    // When disabled, this restores all the hibernated columns
+    m_contentItem->scheduleHibernation();
+    emit hibernationDistanceChanged();
+}
+
+bool ColumnView::asynchronousRestore() const
+{
+    return m_contentItem->m_asynchronousRestore;
+}
+
+void ColumnView::setAsynchronousRestore(bool asynchronous)
+{
+    if (m_contentItem->m_asynchronousRestore == asynchronous) {
+        return;
+    }
+
+    m_contentItem->m_asynchronousRestore = asynchronous;
+    emit asynchronousRestoreChanged();
+}
+
 void ColumnView::addItem(QQuickItem *item)
 {
     insertItem(m_contentItem->m_items.length(), item);
@@ -1066,6 +1603,7 @@ void ColumnView::insertItem(int pos, QQuickItem *item)
     }
 
     m_contentItem->m_items.insert(qBound(0, pos, m_contentItem->m_items.length()), item);
+    m_contentItem->invalidateLayout(pos);
 
     connect(item, &QObject::destroyed, m_contentItem, [this, item]() {
         removeItem(item);
@@ -1091,6 +1629,20 @@ void ColumnView::insertItem(int pos, QQuickItem *item)
     emit itemInserted(pos, item);
 }
 
+QQuickItem *ColumnView::insertComponent(int pos, QQmlComponent *component, const QVariantMap &properties)
+{
+    QQuickItem *item = m_contentItem->createColumn(component, properties);
+    if (!item) {
+        return nullptr;
+    }
+
+    ColumnViewAttached *attached = qobject_cast<ColumnViewAttached *>(qmlAttachedPropertiesObject<ColumnView>(item, true));
+    attached->setComponent(component, properties);
+    insertItem(pos, item);
+
+    return item;
+}
+
 void ColumnView::moveItem(int from, int to)
 {
     if (m_contentItem->m_items.isEmpty()
@@ -1100,6 +1652,7 @@ void ColumnView::moveItem(int from, int to)
     }
 
     m_contentItem->m_items.move(from, to);
+    m_contentItem->invalidateLayout(qMin(from, to));
     m_contentItem->m_shouldAnimate = true;
 
     if (from == m_currentIndex) {
@@ -12,6 +12,7 @@
 
 class ContentItem;
 class ColumnView;
+class QQmlComponent;
 
 /**
  * This is an attached property to every item that is inserted in the ColumnView,
@@ -55,6 +56,14 @@ class ColumnViewAttached : public QObject
      */
     Q_PROPERTY(ColumnView *view READ view NOTIFY viewChanged)
 
+    /**
+     * True if the column is only a placeholder for a hibernated column:
+     * it will be replaced by the real column once it gets close to the viewport again.
+     * @see ColumnView::hibernationDistance
+     * @since 2.15
+     */
+    Q_PROPERTY(bool hibernated READ isHibernated NOTIFY hibernatedChanged)
+
 public:
     ColumnViewAttached(QObject *parent = nullptr);
     ~ColumnViewAttached();
@@ -84,6 +93,14 @@ public:
     bool isPinned() const;
     void setPinned(bool pinned);
 
+    //Private API, not for QML use
+    QQmlComponent *component() const;
+    QVariantMap initialProperties() const;
+    void setComponent(QQmlComponent *component, const QVariantMap &properties);
+
+    bool isHibernated() const;
+    void setHibernated(bool hibernated);
+
 Q_SIGNALS:
     void indexChanged();
     void fillWidthChanged();
@@ -91,6 +108,7 @@ Q_SIGNALS:
     void viewChanged();
     void preventStealingChanged();
     void pinnedChanged();
+    void hibernatedChanged();
 
 private:
     int m_index = -1;
@@ -103,6 +121,10 @@ private:
     bool m_shouldDeleteOnRemove = true;
     bool m_preventStealing = false;
     bool m_pinned = false;
+    bool m_hibernated = false;
+    QPointer<QQmlComponent> m_component;
+    QVariantMap m_initialProperties;
+    friend class ContentItem;
 };
 
 
@@ -219,6 +241,30 @@ class ColumnView : public QQuickItem
      */
     Q_PROPERTY(bool acceptsMouse READ acceptsMouse WRITE setAcceptsMouse NOTIFY acceptsMouseChanged)
 
+    /**
+     * How many columns away from the visible ones a column can be before it gets hibernated.
+     * A hibernated column is destroyed and replaced by an empty placeholder of the same size,
+     * then created again from its component and initial properties when it comes back
+     * within this distance. Only columns created with insertComponent can be hibernated,
+     * never the current or pinned ones.
+     * Any state not passed as initial property is lost, and existing references
+     * to the column item will become null. Initial properties referring to objects
+     * deleted in the meantime are null as well when the column is restored.
+     * Hibernating and restoring a column emit itemHibernated and itemRestored,
+     * and the column keeps its position: the count doesn't change.
+     * default: -1, columns are never hibernated
+     * @since 2.15
+     */
+    Q_PROPERTY(int hibernationDistance READ hibernationDistance WRITE setHibernationDistance NOTIFY hibernationDistanceChanged)
+
+    /**
+     * If true, hibernated columns are created again asynchronously, over several frames.
+     * Their placeholder stays in the view until they are ready.
+     * default: false
+     * @since 2.15
+     */
+    Q_PROPERTY(bool asynchronousRestore READ asynchronousRestore WRITE setAsynchronousRestore NOTIFY asynchronousRestoreChanged)
+
     // Default properties
     /**
      * Every column item the view contains
@@ -291,6 +337,12 @@ public:
     bool acceptsMouse() const;
     void setAcceptsMouse(bool accepts);
 
+    int hibernationDistance() const;
+    void setHibernationDistance(int distance);
+
+    bool asynchronousRestore() const;
+    void setAsynchronousRestore(bool asynchronous);
+
     // Api not intended for QML use
     //can't do overloads in QML
     QQuickItem *removeItem(QQuickItem *item);
@@ -315,6 +367,19 @@ public Q_SLOTS:
      */
     void insertItem(int pos, QQuickItem *item);
 
+    /**
+     * Creates a new column from a component and inserts it in the view at a given position.
+     * Unlike insertItem, the view knows how to create the column again,
+     * so it can hibernate it when it's far from the viewport.
+     * @param pos the position we want the new column to be inserted in
+     * @param component the component the column is created from
+     * @param properties the initial values of the column properties
+     * @returns the new column item, or null if it couldn't be created
+     * @see hibernationDistance
+     * @since 2.15
+     */
+    QQuickItem *insertComponent(int pos, QQmlComponent *component, const QVariantMap &properties = QVariantMap());
+
     /**
      * Move an item inside the view.
      * The currentIndex property may be changed in order to keep currentItem the same.
@@ -386,6 +451,25 @@ Q_SIGNALS:
      */
     void itemRemoved(QQuickItem *item);
 
+    /**
+     * A column far from the viewport has been hibernated,
+     * an empty placeholder took its place
+     * @param position the position of the column
+     * @param item the column item, which is going to be deleted
+     * @see hibernationDistance
+     * @since 2.15
+     */
+    void itemHibernated(int position, QQuickItem *item);
+
+    /**
+     * A hibernated column has been created again and took the place of its placeholder
+     * @param position the position of the column
+     * @param item the new column item
+     * @see hibernationDistance
+     * @since 2.15
+     */
+    void itemRestored(int position, QQuickItem *item);
+
     // Property notifiers
     void contentChildrenChanged();
     void columnResizeModeChanged();
@@ -406,6 +490,8 @@ Q_SIGNALS:
     void lastVisibleItemChanged();
     void topPaddingChanged();
     void bottomPaddingChanged();
+    void hibernationDistanceChanged();
+    void asynchronousRestoreChanged();
 
 private:
     static void contentChildren_append(QQmlListProperty<QQuickItem> *prop, QQuickItem *object);
@@ -438,6 +524,7 @@ private:
     bool m_separatorVisible = true;
     bool m_complete = false;
     bool m_acceptsMouse = false;
+    friend class ContentItem;
 };
 
 QML_DECLARE_TYPEINFO(ColumnView, QML_HAS_ATTACHED_PROPERTIES)
@@ -10,6 +10,9 @@
 
 #include <QQuickItem>
 #include <QPointer>
+#include <QQmlIncubator>
+
+#include <functional>
 
 class QPropertyAnimation;
 class QQmlComponent;
@@ -22,8 +25,6 @@ public:
     QmlComponentsPool(QQmlEngine *engine);
     ~QmlComponentsPool();
 
-    QQmlComponent *m_separatorComponent = nullptr;
-    QQmlComponent *m_rightSeparatorComponent = nullptr;
     QObject *m_units = nullptr;
 
 Q_SIGNALS:
@@ -34,6 +35,54 @@ private:
     QObject *m_instance = nullptr;
 };
 
+/*
+ * Creates a hibernated column again, with its initial properties
+ */
+class ColumnIncubator : public QQmlIncubator
+{
+public:
+    ColumnIncubator(const QVariantMap &properties, QQmlContext *context, std::function<void(QQuickItem *)> callback);
+
+private:
+    void setInitialState(QObject *object) override;
+    void statusChanged(QQmlIncubator::Status status) override;
+
+    // As stored by ColumnViewAttached, with the objects guarded
+    QVariantMap m_properties;
+    QPointer<QQmlContext> m_context;
+    std::function<void(QQuickItem *)> m_callback;
+};
+
+class ContentItem;
+
+/*
+ * Draws the separators of all the columns of a ContentItem in a single node.
+ * It sits above the ContentItem, as an item is always drawn below its children.
+ */
+class ColumnSeparators : public QQuickItem
+{
+public:
+    ColumnSeparators(ContentItem *contentItem, QQuickItem *parent);
+
+    void forgetColor(QQuickItem *column);
+
+protected:
+    void updatePolish() override;
+    QSGNode *updatePaintNode(QSGNode *node, QQuickItem::UpdatePaintNodeData *data) override;
+
+private:
+    struct Separator {
+        QRectF rect;
+        QColor color;
+    };
+
+    QColor separatorColor(QQuickItem *column);
+
+    ContentItem *m_contentItem;
+    QVector<Separator> m_separators;
+    QHash<QQuickItem *, QColor> m_colors;
+};
+
 class ContentItem : public QQuickItem
 {
     Q_OBJECT
@@ -45,10 +94,20 @@ public:
     void layoutItems();
     void layoutPinnedItems();
     qreal childWidth(QQuickItem *child);
+    qreal childWidth(QQuickItem *child, ColumnViewAttached *attached);
+    ColumnViewAttached *attachedFor(QQuickItem *item);
+    QQuickItem *itemAtLayoutPosition(int position) const;
+    void invalidateLayout(int index);
     void updateVisibleItems();
     void forgetItem(QQuickItem *item);
-    QQuickItem *ensureSeparator(QQuickItem *item);
-    QQuickItem *ensureRightSeparator(QQuickItem *item);
+    qreal separatorWidth() const;
+
+    QQuickItem *createColumn(QQmlComponent *component, const QVariantMap &properties);
+    void scheduleHibernation();
+    void updateHibernation();
+    void hibernateItem(int index);
+    void restoreItem(int index);
+    void replaceItem(int index, QQuickItem *item);
 
     void setBoundedX(qreal x);
     void animateX(qreal x);
@@ -57,6 +116,10 @@ public:
     inline qreal viewportLeft() const;
     inline qreal viewportRight() const;
 
+Q_SIGNALS:
+    // After every layout pass, for the benchmark
+    void itemsLaidOut();
+
 protected:
     void itemChange(QQuickItem::ItemChange change, const QQuickItem::ItemChangeData &value) override;
     void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
@@ -71,17 +134,41 @@ private:
     QList<QQuickItem *> m_items;
     QList<QObject *> m_visibleItems;
     QPointer<QQuickItem> m_viewAnchorItem;
-    QHash<QQuickItem *, QQuickItem *> m_separators;
-    QHash<QQuickItem *, QQuickItem *> m_rightSeparators;
+    ColumnSeparators *m_separatorsItem;
     QHash<QObject *, QObject*> m_models;
+    QHash<QQuickItem *, ColumnIncubator *> m_incubators;
+    QHash<QQuickItem *, ColumnViewAttached *> m_attachedObjects;
+
+    // Where every column starts, in layout order, and the total width as last entry
+    QVector<qreal> m_columnOffsets = {0};
+    // Sum of the implicit widths and max of the implicit heights of the columns before each one
+    QVector<qreal> m_implicitWidths = {0};
+    QVector<qreal> m_implicitHeights = {0};
+    // Pinned columns are positioned separately, by layoutPinnedItems()
+    QVector<int> m_pinnedPositions;
+    // First column whose geometry needs to be updated
+    int m_layoutFrom = 0;
+    bool m_layouting = false;
+
+    // What all the columns depend on, as of the last layout
+    bool m_layoutReverse = false;
+    qreal m_layoutHeight = 0;
+    qreal m_layoutViewWidth = 0;
+    qreal m_layoutColumnWidth = 0;
+    ColumnView::ColumnResizeMode m_layoutResizeMode = ColumnView::FixedColumns;
+    bool m_layoutSeparatorVisible = true;
 
     qreal m_leftPinnedSpace = 361;
     qreal m_rightPinnedSpace = 0;
 
     qreal m_columnWidth = 0;
     qreal m_lastDragDelta = 0;
+    int m_hibernationDistance = -1;
+    bool m_asynchronousRestore = false;
+    bool m_hibernationScheduled = false;
     ColumnView::ColumnResizeMode m_columnResizeMode = ColumnView::FixedColumns;
     bool m_shouldAnimate = false;
     friend class ColumnView;
+    friend class ColumnSeparators;
 };
 
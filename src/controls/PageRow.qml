@@ -127,6 +127,19 @@ T.Control {
      */
     property alias separatorVisible: columnView.separatorVisible
 
+    /**
+     * hibernationDistance: int
+     * How many pages away from the visible ones a page can be before it gets
+     * destroyed to save memory. It is created again, with the same properties
+     * it was pushed with, when it comes back close to the view.
+     * Only pages pushed as urls or components while it's enabled can be hibernated,
+     * and their properties shouldn't include functions, which can't be kept.
+     * default: -1, pages are never hibernated
+     * @see ColumnView::hibernationDistance
+     * @since 2.15
+     */
+    property alias hibernationDistance: columnView.hibernationDistance
+
     /**
      * globalToolBar: grouped property
      * Controls the appearance of an optional global toolbar for the whole PageRow.
@@ -333,6 +346,25 @@ T.Control {
      */
     signal pageRemoved(Item page)
 
+    /**
+     * Emitted when a page far from the view has been hibernated:
+     * an empty placeholder takes its place until it's needed again.
+     * @param position the position of the page
+     * @param page the page, which is going to be deleted
+     * @see hibernationDistance
+     * @since 2.15
+     */
+    signal pageHibernated(int position, Item page)
+
+    /**
+     * Emitted when a hibernated page has been created again
+     * @param position the position of the page
+     * @param page the new page
+     * @see hibernationDistance
+     * @since 2.15
+     */
+    signal pageRestored(int position, Item page)
+
     /**
      * Replaces a page on the stack.
      * @param page The page can also be given as an array of pages.
@@ -369,7 +401,7 @@ T.Control {
     }
 
     /**
-     * @return the page at idx
+     * @return the page at idx, or the Item holding its place while it's hibernated
      * @param idx the depth of the page we want
      */
     function get(idx) {
@@ -563,8 +595,14 @@ T.Control {
             if (pageComp) {
                 // instantiate page from component
                 // FIXME: parent directly to columnView or root?
-                page = pageComp.createObject(null, properties || {});
-                columnView.insertItem(position, page);
+                if (columnView.hibernationDistance >= 0) {
+                    // The properties become a map the page can be created again with,
+                    // which only keeps what can be copied
+                    page = columnView.insertComponent(position, pageComp, properties || {});
+                } else {
+                    page = pageComp.createObject(null, properties || {});
+                    columnView.insertItem(position, page);
+                }
 
                 if (pageComp.status === Component.Error) {
                     throw new Error("Error while loading page: " + pageComp.errorString());
@@ -597,6 +635,8 @@ T.Control {
 
         onItemInserted: root.pageInserted(position, item);
         onItemRemoved: root.pageRemoved(item);
+        onItemHibernated: root.pageHibernated(position, item);
+        onItemRestored: root.pageRestored(position, item);
     }
 
     Rectangle {
@@ -55,7 +55,8 @@ Flickable {
                 RowLayout {
                     id: delegateLayout
                     anchors.fill: parent
-                    readonly property Kirigami.Page page: pageRow.get(modelData)
+                    // A hibernated page is only a placeholder Item, until it's created again
+                    readonly property Item page: pageRow.get(modelData)
                     spacing: 0
 
                     Kirigami.Icon {
@@ -68,11 +69,18 @@ Flickable {
                         source: LayoutMirroring.enabled ? "go-next-symbolic-rtl" : "go-next-symbolic"
                     }
                     Kirigami.Heading {
+                        id: heading
                         Layout.leftMargin: Kirigami.Units.largeSpacing
                         color: Kirigami.Theme.textColor
                         verticalAlignment: Text.AlignVCenter
                         wrapMode: Text.NoWrap
-                        text: delegateLayout.page ? delegateLayout.page.title : ""
+                        // Keeps the title of a hibernated page
+                        Binding {
+                            when: delegateLayout.page && delegateLayout.page.title !== undefined
+                            target: heading
+                            property: "text"
+                            value: delegateLayout.page ? delegateLayout.page.title : ""
+                        }
                         opacity: modelData == pageRow.currentIndex ? 1 : 0.4
                         rightPadding: Kirigami.Units.largeSpacing
                     }
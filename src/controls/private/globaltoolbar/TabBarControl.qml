@@ -18,14 +18,22 @@ Controls.TabBar {
         id: mainRepeater
         model: pageRow.depth
         delegate: Controls.TabButton {
+            id: tabButton
             anchors {
                 top:parent.top
                 bottom:parent.bottom
             }
             width: mainRepeater.count == 1 ? implicitWidth : Math.max(implicitWidth, Math.round(root.width/mainRepeater.count))
             height: root.height
-            readonly property Kirigami.Page page: pageRow.get(modelData)
-            text: page ? page.title : ""
+            // A hibernated page is only a placeholder Item, until it's created again
+            readonly property Item page: pageRow.get(modelData)
+            // Keeps the title of a hibernated page
+            Binding {
+                when: tabButton.page && tabButton.page.title !== undefined
+                target: tabButton
+                property: "text"
+                value: tabButton.page ? tabButton.page.title : ""
+            }
             checked: modelData == pageRow.currentIndex
             onClicked: pageRow.currentIndex = modelData;
         }
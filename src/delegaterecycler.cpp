@@ -10,8 +10,14 @@
 #include <QQmlComponent>
 #include <QQmlContext>
 #include <QQmlEngine>
+#include <QQmlIncubator>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
 #include <QDebug>
 
+#include <functional>
+
 DelegateRecyclerAttached::DelegateRecyclerAttached(QObject *parent)
     : QObject(parent)
 {
@@ -33,61 +39,258 @@ DelegateRecycler *recycler() const
 
 
 
-class DelegateCache
+/**
+ * Creates a delegate incrementally, in the idle time between frames.
+ */
+class DelegateIncubator : public QQmlIncubator
+{
+public:
+    DelegateIncubator(QQmlContext *context, std::function<void(QQuickItem *)> callback)
+        : QQmlIncubator(QQmlIncubator::Asynchronous)
+        , m_context(context)
+        , m_callback(callback)
+    {
+    }
+
+    QQmlContext *context() const
+    {
+        return m_context;
+    }
+
+protected:
+    void statusChanged(QQmlIncubator::Status status) override
+    {
+        if (status == QQmlIncubator::Error) {
+            qWarning() << "Could not create delegate" << errors();
+            m_callback(nullptr);
+        } else if (status == QQmlIncubator::Ready) {
+            QQuickItem *item = qobject_cast<QQuickItem *>(object());
+            if (!item) {
+                delete object();
+            }
+            m_callback(item);
+        }
+    }
+
+private:
+    QQmlContext *m_context;
+    std::function<void(QQuickItem *)> m_callback;
+};
+
+/**
+ * The context object to give the context of new delegates, so they get the
+ * translation domain of the application: the first KLocalizedContext found.
+ */
+static QObject *translationContextObject(QQmlContext *ctx)
+{
+    while (ctx) {
+        QObject *contextObject = ctx->contextObject();
+        if (contextObject && contextObject->property("translationDomain").isValid()) {
+            return contextObject;
+        }
+        ctx = ctx->parentContext();
+    }
+    return nullptr;
+}
+
+// Pools never shrink below this, so a list can always scroll a bit without creating delegates
+static const int s_minPoolSize = 4;
+// Pools not reused for this long are halved
+static const int s_trimInterval = 10000;
+// Rough memory used by a QObject of a delegate, QML items mostly, with their bindings
+static const qint64 s_bytesPerObject = 512;
+static const qint64 s_defaultMemoryBudget = 16 * 1024 * 1024;
+
+/**
+ * The delegates of an engine, kept around after their DelegateRecycler is gone so
+ * the next one using the same component can take them back instead of creating one.
+ *
+ * Every component gets a pool as big as the most delegates of it which were alive at
+ * the same time: that's as many as a list can give back at once when it scrolls.
+ * Pools which aren't reused shrink again over time, and the pools of the engine
+ * together stay within a memory budget.
+ */
+class DelegateCache : public QObject
 {
 public:
-    DelegateCache();
+    struct Statistics {
+        /// Delegates taken from a pool
+        qint64 hits = 0;
+        /// Delegates which had to be created
+        qint64 misses = 0;
+        /// Delegates deleted rather than pooled, or dropped from their pool
+        qint64 evictions = 0;
+        /// Delegates currently pooled
+        qint64 pooledItems = 0;
+        /// Estimated memory used by the pooled delegates
+        qint64 pooledBytes = 0;
+    };
+
+    explicit DelegateCache(QQmlEngine *engine);
     ~DelegateCache();
 
+    static DelegateCache *instance(QQmlEngine *engine);
+
     void ref(QQmlComponent *);
     void deref(QQmlComponent *);
 
     void insert(QQmlComponent *, QQuickItem *);
     QQuickItem *take(QQmlComponent *);
 
+    /**
+     * The implicit size the delegates of @p component had last time one was
+     * created or pooled, to estimate the size of the next one. Invalid until then.
+     */
+    QSizeF estimatedImplicitSize(QQmlComponent *component) const;
+    void setImplicitSize(QQmlComponent *component, const QSizeF &size);
+
+    /**
+     * Creates @p count delegates of @p component in the idle time between frames,
+     * and pools them until a DelegateRecycler needs them.
+     */
+    void prewarm(QQmlComponent *component, int count);
+
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+    Statistics statistics() const;
+
 private:
-    static const int s_cacheSize = 40;
-    QHash<QQmlComponent *, int> m_refs;
-    QHash<QQmlComponent *, QList<QQuickItem *> > m_unusedItems;
+    struct Pool {
+        QVector<QQuickItem *> items;
+        // DelegateRecyclers currently using the component
+        int refs = 0;
+        // The most DelegateRecyclers which used it at the same time
+        int highWater = 0;
+        // Items taken since the last trim
+        int taken = 0;
+        // Estimated memory of one item, measured on the first one pooled
+        qint64 itemBytes = 0;
+        quint64 lastUse = 0;
+        // Items asked for by prewarm(), kept until the first DelegateRecycler uses the component
+        int reserved = 0;
+        // Items prewarm() still has to create
+        int toWarm = 0;
+        QSizeF implicitSize;
+    };
+
+    QHash<QQmlComponent *, Pool>::iterator findOrCreatePool(QQmlComponent *component);
+    int capacity(const Pool &pool) const;
+    void addItem(Pool &pool, QQuickItem *item);
+    void dropItems(Pool &pool, int count);
+    void deletePool(QQmlComponent *component);
+    void trim();
+    void enforceBudget();
+    void warmNext();
+
+    QQmlEngine *m_engine;
+    QHash<QQmlComponent *, Pool> m_pools;
+    QTimer m_trimTimer;
+    QTimer m_warmTimer;
+    DelegateIncubator *m_warmIncubator = nullptr;
+    qint64 m_budget = s_defaultMemoryBudget;
+    quint64 m_clock = 0;
+    Statistics m_statistics;
 };
 
-Q_GLOBAL_STATIC(DelegateCache, s_delegateCache)
+// Engines can live in different threads
+static QMutex s_delegateCachesMutex;
+static QHash<QQmlEngine *, DelegateCache *> s_delegateCaches;
 
-DelegateCache::DelegateCache()
+DelegateCache::DelegateCache(QQmlEngine *engine)
+    : QObject(engine)
+    , m_engine(engine)
 {
+    m_trimTimer.setSingleShot(true);
+    m_trimTimer.setInterval(s_trimInterval);
+    connect(&m_trimTimer, &QTimer::timeout, this, &DelegateCache::trim);
+
+    // Queued, so prewarm() returns at once: the incubator then only progresses
+    // in the idle time the incubation controller of the window gives it after
+    // each frame, so the first frame is never held up by prewarmed delegates
+    m_warmTimer.setSingleShot(true);
+    m_warmTimer.setInterval(0);
+    connect(&m_warmTimer, &QTimer::timeout, this, &DelegateCache::warmNext);
+
+    bool ok = false;
+    const qint64 budget = qEnvironmentVariableIntValue("KIRIGAMI_DELEGATE_CACHE_BUDGET", &ok);
+    m_budget = ok && budget >= 0 ? budget * 1024 * 1024 : s_defaultMemoryBudget;
 }
 
 DelegateCache::~DelegateCache()
 {
-    for (auto& item : qAsConst(m_unusedItems)) {
-        qDeleteAll(item);
+    {
+        QMutexLocker locker(&s_delegateCachesMutex);
+        s_delegateCaches.remove(m_engine);
+    }
+    if (m_warmIncubator) {
+        m_warmIncubator->clear();
+        delete m_warmIncubator;
     }
+    for (auto &pool : qAsConst(m_pools)) {
+        qDeleteAll(pool.items);
+    }
+}
+
+DelegateCache *DelegateCache::instance(QQmlEngine *engine)
+{
+    if (!engine) {
+        return nullptr;
+    }
+
+    QMutexLocker locker(&s_delegateCachesMutex);
+    DelegateCache *&cache = s_delegateCaches[engine];
+    if (!cache) {
+        cache = new DelegateCache(engine);
+    }
+    return cache;
+}
+
+QHash<QQmlComponent *, DelegateCache::Pool>::iterator DelegateCache::findOrCreatePool(QQmlComponent *component)
+{
+    auto it = m_pools.find(component);
+    if (it == m_pools.end()) {
+        it = m_pools.insert(component, Pool());
+        // Without this the pool would stay around, keyed by a dangling pointer
+        connect(component, &QObject::destroyed, this, [this, component]() {
+            deletePool(component);
+        });
+    }
+    return it;
 }
 
 void DelegateCache::ref(QQmlComponent *component)
 {
-    m_refs[component]++;
+    auto it = findOrCreatePool(component);
+    ++it->refs;
+    it->highWater = qMax(it->highWater, it->refs);
+    // From now on the pool adapts to how the component is actually used
+    it->reserved = 0;
 }
 
 void DelegateCache::deref(QQmlComponent *component)
 {
-    auto itRef = m_refs.find(component);
-    if (itRef == m_refs.end()) {
+    auto it = m_pools.find(component);
+    if (it == m_pools.end()) {
         return;
     }
 
-    (*itRef)--;
-    if (*itRef <= 0) {
-        m_refs.erase(itRef);
-
-        qDeleteAll(m_unusedItems.take(component));
+    --it->refs;
+    if (it->refs <= 0) {
+        disconnect(component, nullptr, this, nullptr);
+        deletePool(component);
     }
 }
 
 void DelegateCache::insert(QQmlComponent *component, QQuickItem *item)
 {
-    auto& items = m_unusedItems[component];
-    if (items.length() >= s_cacheSize) {
+    if (!item) {
+        return;
+    }
+
+    auto it = m_pools.find(component);
+    if (it == m_pools.end() || it->items.count() >= capacity(*it)) {
+        ++m_statistics.evictions;
         item->deleteLater();
         return;
     }
@@ -98,21 +301,278 @@ void DelegateCache::insert(QQmlComponent *component, QQuickItem *item)
     }
 
     item->setParentItem(nullptr);
-    items.append(item);
+    addItem(*it, item);
 }
 
 QQuickItem *DelegateCache::take(QQmlComponent *component)
 {
-    auto it = m_unusedItems.find(component);
-    if (it != m_unusedItems.end() && !it->isEmpty()) {
-        return it->takeFirst();
+    auto it = m_pools.find(component);
+    if (it == m_pools.end() || it->items.isEmpty()) {
+        ++m_statistics.misses;
+        return nullptr;
+    }
+
+    ++m_statistics.hits;
+    ++it->taken;
+    it->lastUse = ++m_clock;
+    --m_statistics.pooledItems;
+    m_statistics.pooledBytes -= it->itemBytes;
+
+    // The last one pooled is the most likely to still be in the CPU caches
+    return it->items.takeLast();
+}
+
+QSizeF DelegateCache::estimatedImplicitSize(QQmlComponent *component) const
+{
+    return m_pools.value(component).implicitSize;
+}
+
+void DelegateCache::setImplicitSize(QQmlComponent *component, const QSizeF &size)
+{
+    auto it = m_pools.find(component);
+    if (it != m_pools.end()) {
+        it->implicitSize = size;
+    }
+}
+
+void DelegateCache::prewarm(QQmlComponent *component, int count)
+{
+    if (!component || count <= 0) {
+        return;
+    }
+
+    if (component->isError()) {
+        qWarning() << "Could not prewarm delegates" << component->errors();
+        return;
+    }
+
+    auto it = findOrCreatePool(component);
+    it->highWater = qMax(it->highWater, count);
+    if (it->refs == 0) {
+        it->reserved = qMax(it->reserved, count);
+    }
+    it->toWarm = qMax(it->toWarm, count - it->items.count());
+
+    if (!m_warmIncubator || !m_warmIncubator->isLoading()) {
+        m_warmTimer.start();
     }
-    return nullptr;
 }
 
+void DelegateCache::warmNext()
+{
+    if (m_warmIncubator && m_warmIncubator->isLoading()) {
+        return;
+    }
+    // Done with the last delegate, it couldn't be deleted from its own callback
+    delete m_warmIncubator;
+    m_warmIncubator = nullptr;
+
+    QQmlComponent *component = nullptr;
+    for (auto it = m_pools.begin(); it != m_pools.end(); ++it) {
+        if (it->toWarm > 0) {
+            component = it.key();
+            break;
+        }
+    }
+    if (!component) {
+        return;
+    }
+
+    // Still loading, try again once it's ready
+    if (component->isLoading()) {
+        connect(component, &QQmlComponent::statusChanged, &m_warmTimer, static_cast<void (QTimer::*)()>(&QTimer::start), Qt::UniqueConnection);
+        return;
+    }
 
+    QQmlContext *parentCtx = component->creationContext() ? component->creationContext() : m_engine->rootContext();
+    QQmlContext *ctx = new QQmlContext(parentCtx, this);
+    if (QObject *contextObject = translationContextObject(ctx)) {
+        ctx->setContextObject(contextObject);
+    }
+    // Set for real by the DelegateRecycler which takes the delegate. An empty
+    // object as model, so bindings on model.role see undefined instead of throwing
+    ctx->setContextProperties({ QQmlContext::PropertyPair{ QStringLiteral("model"), QVariantMap() },
+                                QQmlContext::PropertyPair{ QStringLiteral("modelData"), QVariant() },
+                                QQmlContext::PropertyPair{ QStringLiteral("index"), -1 },
+                                QQmlContext::PropertyPair{ QStringLiteral("delegateRecycler"), QVariant::fromValue<QObject *>(nullptr) }
+                             });
+
+    QPointer<QQmlComponent> guard(component);
+    m_warmIncubator = new DelegateIncubator(ctx, [this, guard, ctx](QQuickItem *item) {
+        auto it = guard ? m_pools.find(guard) : m_pools.end();
+        if (!item || it == m_pools.end()) {
+            // Don't try again forever with a broken component
+            if (it != m_pools.end()) {
+                it->toWarm = 0;
+            }
+            delete item;
+            ctx->deleteLater();
+        } else {
+            connect(item, &QObject::destroyed, ctx, &QObject::deleteLater);
+            --it->toWarm;
+            addItem(*it, item);
+        }
 
+        m_warmTimer.start();
+    });
+    component->create(*m_warmIncubator, ctx);
 
+    // Without an incubation controller, which windows install on their engine,
+    // nothing would ever drive the incubator: one delegate per event loop pass it is
+    if (m_warmIncubator->isLoading() && !m_engine->incubationController()) {
+        m_warmIncubator->forceCompletion();
+    }
+}
+
+qint64 DelegateCache::memoryBudget() const
+{
+    return m_budget;
+}
+
+void DelegateCache::setMemoryBudget(qint64 bytes)
+{
+    m_budget = qMax(qint64(0), bytes);
+    enforceBudget();
+}
+
+DelegateCache::Statistics DelegateCache::statistics() const
+{
+    return m_statistics;
+}
+
+int DelegateCache::capacity(const Pool &pool) const
+{
+    return qMax(s_minPoolSize, pool.highWater);
+}
+
+void DelegateCache::addItem(Pool &pool, QQuickItem *item)
+{
+    if (pool.itemBytes == 0) {
+        pool.itemBytes = (item->findChildren<QObject *>().count() + 1) * s_bytesPerObject;
+    }
+    pool.items.append(item);
+    pool.implicitSize = QSizeF(item->implicitWidth(), item->implicitHeight());
+    pool.lastUse = ++m_clock;
+    ++m_statistics.pooledItems;
+    m_statistics.pooledBytes += pool.itemBytes;
+
+    enforceBudget();
+    m_trimTimer.start();
+}
+
+void DelegateCache::dropItems(Pool &pool, int count)
+{
+    // The oldest ones go first. Not right away: through insert(), this can
+    // run from a handler of the delegate being given back
+    count = qBound(0, count, pool.items.count());
+    for (int i = 0; i < count; ++i) {
+        pool.items[i]->deleteLater();
+    }
+    pool.items.remove(0, count);
+
+    m_statistics.evictions += count;
+    m_statistics.pooledItems -= count;
+    m_statistics.pooledBytes -= count * pool.itemBytes;
+}
+
+void DelegateCache::deletePool(QQmlComponent *component)
+{
+    auto it = m_pools.find(component);
+    if (it == m_pools.end()) {
+        return;
+    }
+
+    m_statistics.pooledItems -= it->items.count();
+    m_statistics.pooledBytes -= it->items.count() * it->itemBytes;
+    // Also reached from insert() and deref(), like dropItems()
+    for (QQuickItem *item : qAsConst(it->items)) {
+        item->deleteLater();
+    }
+    m_pools.erase(it);
+}
+
+void DelegateCache::trim()
+{
+    bool pooled = false;
+    for (auto &pool : m_pools) {
+        if (pool.taken == 0) {
+            // Nothing scrolled for a while, or the list got smaller: give memory back
+            pool.highWater = qMax(qMax(pool.refs, pool.reserved), pool.highWater / 2);
+            const int count = qMax((pool.items.count() + 1) / 2, pool.items.count() - capacity(pool));
+            dropItems(pool, qMin(count, pool.items.count() - pool.reserved));
+        }
+        pool.taken = 0;
+        pooled = pooled || pool.items.count() > pool.reserved;
+    }
+
+    if (pooled) {
+        m_trimTimer.start();
+    }
+}
+
+void DelegateCache::enforceBudget()
+{
+    // Empty the least recently used pools first
+    while (m_statistics.pooledBytes > m_budget) {
+        Pool *oldest = nullptr;
+        for (auto &pool : m_pools) {
+            if (!pool.items.isEmpty() && (!oldest || pool.lastUse < oldest->lastUse)) {
+                oldest = &pool;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        dropItems(*oldest, 1);
+    }
+}
+
+DelegateRecyclerCache::DelegateRecyclerCache(QQmlEngine *engine, QObject *parent)
+    : QObject(parent)
+    , m_engine(engine)
+{
+}
+
+qint64 DelegateRecyclerCache::memoryBudget() const
+{
+    DelegateCache *cache = DelegateCache::instance(m_engine);
+    return cache ? cache->memoryBudget() : 0;
+}
+
+void DelegateRecyclerCache::setMemoryBudget(qint64 bytes)
+{
+    DelegateCache *cache = DelegateCache::instance(m_engine);
+    if (!cache || bytes == cache->memoryBudget()) {
+        return;
+    }
+    cache->setMemoryBudget(bytes);
+    emit memoryBudgetChanged();
+}
+
+void DelegateRecyclerCache::prewarm(QQmlComponent *component, int count)
+{
+    DelegateCache *cache = DelegateCache::instance(m_engine);
+    if (cache) {
+        cache->prewarm(component, count);
+    }
+}
+
+QVariantMap DelegateRecyclerCache::statistics() const
+{
+    DelegateCache *cache = DelegateCache::instance(m_engine);
+    if (!cache) {
+        return QVariantMap();
+    }
+
+    const DelegateCache::Statistics statistics = cache->statistics();
+    return {
+        {QStringLiteral("hits"), statistics.hits},
+        {QStringLiteral("misses"), statistics.misses},
+        {QStringLiteral("evictions"), statistics.evictions},
+        {QStringLiteral("pooledItems"), statistics.pooledItems},
+        {QStringLiteral("pooledBytes"), statistics.pooledBytes},
+    };
+}
 
 DelegateRecycler::DelegateRecycler(QQuickItem *parent)
     : QQuickItem(parent)
@@ -122,67 +582,160 @@ DelegateRecycler::DelegateRecycler(QQuickItem *parent)
 
 DelegateRecycler::~DelegateRecycler()
 {
-    if (m_sourceComponent) {
-        s_delegateCache->insert(m_sourceComponent, m_item);
-        s_delegateCache->deref(m_sourceComponent);
+    cancelIncubation();
+    if (m_sourceComponent && m_cache) {
+        m_cache->insert(m_sourceComponent, m_item);
+        m_cache->deref(m_sourceComponent);
     }
 }
 
+struct TrackedPropertyInfo {
+    const char *name;
+    const char *slot;
+};
+
+// In the order of DelegateRecycler::TrackedProperty
+static const TrackedPropertyInfo s_trackedProperties[] = {
+    {"index", "syncIndex()"},
+    {"model", "syncModel()"},
+    {"modelData", "syncModelData()"},
+};
+
+void DelegateRecycler::trackModel()
+{
+    m_trackingModel = true;
+
+    QQmlContext *ownCtx = QQmlEngine::contextForObject(this);
+    for (int i = IndexProperty; i <= ModelDataProperty; ++i) {
+        // Usually the model item the view set as context object of its delegates,
+        // either ours or the one of the delegate we are in
+        for (QQmlContext *ctx = ownCtx; ctx; ctx = ctx->parentContext()) {
+            QObject *owner = ctx->contextObject();
+            const int propertyIndex = owner ? owner->metaObject()->indexOfProperty(s_trackedProperties[i].name) : -1;
+            if (propertyIndex < 0) {
+                continue;
+            }
+
+            const QMetaProperty property = owner->metaObject()->property(propertyIndex);
+            if (property.hasNotifySignal()) {
+                const QMetaMethod slot = metaObject()->method(metaObject()->indexOfSlot(s_trackedProperties[i].slot));
+                connect(owner, property.notifySignal(), this, slot);
+            }
+            break;
+        }
+    }
+}
+
+QVariant DelegateRecycler::trackedProperty(TrackedProperty property) const
+{
+    // Resolved the same way as in QML, which is also right when the property
+    // comes from a context property rather than from the object we track
+    QQmlContext *ctx = QQmlEngine::contextForObject(this);
+    const QVariant value = ctx ? ctx->contextProperty(QString::fromLatin1(s_trackedProperties[property].name)) : QVariant();
+    if (!value.isValid() && property != IndexProperty) {
+        return QVariant::fromValue<QObject *>(nullptr);
+    }
+    return value;
+}
+
+QQmlContext *DelegateRecycler::delegateContext() const
+{
+    if (m_item) {
+        return QQmlEngine::contextForObject(m_item)->parentContext();
+    }
+    return m_incubator && m_incubator->isLoading() ? m_incubator->context() : nullptr;
+}
+
 void DelegateRecycler::syncIndex()
 {
-    const QVariant newIndex = m_propertiesTracker->property("trackedIndex");
+    const QVariant newIndex = trackedProperty(IndexProperty);
     if (!newIndex.isValid()) {
         return;
     }
-    QQmlContext *ctx = QQmlEngine::contextForObject(m_item)->parentContext();
-    ctx->setContextProperty(QStringLiteral("index"), newIndex);
+    QQmlContext *ctx = delegateContext();
+    if (ctx) {
+        ctx->setContextProperty(QStringLiteral("index"), newIndex);
+    }
 }
 
 void DelegateRecycler::syncModel()
 {
-    const QVariant newModel = m_propertiesTracker->property("trackedModel");
+    const QVariant newModel = trackedProperty(ModelProperty);
     if (!newModel.isValid()) {
         return;
     }
-    QQmlContext *ctx = QQmlEngine::contextForObject(m_item)->parentContext();
+    QQmlContext *ctx = delegateContext();
+    if (!ctx) {
+        return;
+    }
     ctx->setContextProperty(QStringLiteral("model"), newModel);
 
+    setModelObject(ctx, newModel.value<QObject *>());
+}
+
+void DelegateRecycler::setModelObject(QQmlContext *ctx, QObject *modelObj)
+{
+    const QMetaMethod updateSlot = staticMetaObject.method(staticMetaObject.indexOfSlot("syncModelProperties()"));
+
+    if (modelObj != m_modelObject) {
+        // A reused delegate must stop following the row it showed before
+        if (m_modelObject) {
+            disconnect(m_modelObject, QMetaMethod(), this, updateSlot);
+        }
+        m_modelObject = modelObj;
+    }
+
+    if (!modelObj) {
+        return;
+    }
+
     //try to bind all properties
-    QObject *modelObj = newModel.value<QObject *>();
-    if (modelObj) {
-        const QMetaObject *metaObj = modelObj->metaObject();
-        for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
-            ctx->setContextProperty(QString::fromUtf8(metaObj->property(i).name()), metaObj->property(i).read(modelObj));
+    const QMetaObject *metaObj = modelObj->metaObject();
+    for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
+        const QMetaProperty prop = metaObj->property(i);
+        ctx->setContextProperty(QString::fromUtf8(prop.name()), prop.read(modelObj));
+        if (prop.hasNotifySignal()) {
+            // Roles often share their notify signal
+            connect(modelObj, prop.notifySignal(), this, updateSlot, Qt::UniqueConnection);
         }
     }
 }
 
 void DelegateRecycler::syncModelProperties()
 {
-    const QVariant model = m_propertiesTracker->property("trackedModel");
-    if (!model.isValid()) {
+    QObject *modelObj = sender();
+    QQmlContext *ctx = delegateContext();
+    if (!ctx || !modelObj || modelObj != m_modelObject) {
         return;
     }
-    QQmlContext *ctx = QQmlEngine::contextForObject(m_item)->parentContext();
 
-    //try to bind all properties
-    QObject *modelObj = model.value<QObject *>();
-    if (modelObj) {
-        const QMetaObject *metaObj = modelObj->metaObject();
-        for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
-            ctx->setContextProperty(QString::fromUtf8(metaObj->property(i).name()), metaObj->property(i).read(modelObj));
+    // Only update the properties notified by this signal: every context property
+    // written invalidates all the bindings of the delegate using the context
+    const int signalIndex = senderSignalIndex();
+    const QMetaObject *metaObj = modelObj->metaObject();
+    for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
+        const QMetaProperty prop = metaObj->property(i);
+        if (prop.notifySignalIndex() != signalIndex) {
+            continue;
+        }
+        const QString name = QString::fromUtf8(prop.name());
+        const QVariant value = prop.read(modelObj);
+        if (ctx->contextProperty(name) != value) {
+            ctx->setContextProperty(name, value);
         }
     }
 }
 
 void DelegateRecycler::syncModelData()
 {
-    const QVariant newModelData = m_propertiesTracker->property("trackedModelData");
+    const QVariant newModelData = trackedProperty(ModelDataProperty);
     if (!newModelData.isValid()) {
         return;
     }
-    QQmlContext *ctx = QQmlEngine::contextForObject(m_item)->parentContext();
-    ctx->setContextProperty(QStringLiteral("modelData"), newModelData);
+    QQmlContext *ctx = delegateContext();
+    if (ctx) {
+        ctx->setContextProperty(QStringLiteral("modelData"), newModelData);
+    }
 }
 
 QQmlComponent *DelegateRecycler::sourceComponent() const
@@ -200,43 +753,31 @@ void DelegateRecycler::setSourceComponent(QQmlComponent *component)
         return;
     }
 
-    if (!m_propertiesTracker) {
-        static QHash<QQmlEngine*, QQmlComponent*> propertiesTrackerComponent;
-        auto engine = qmlEngine(this);
-        auto it = propertiesTrackerComponent.find(engine);
-        if (it == propertiesTrackerComponent.end()) {
-            connect(engine, &QObject::destroyed, engine, [engine] { propertiesTrackerComponent.remove(engine); });
-            it = propertiesTrackerComponent.insert(engine, new QQmlComponent(engine, engine));
-
-            (*it)->setData(QByteArrayLiteral(R"(
-import QtQuick 2.3
-QtObject {
-    property int trackedIndex: index
-    property var trackedModel: typeof model != 'undefined' ? model : null
-    property var trackedModelData: typeof modelData != 'undefined' ? modelData : null
-}
-)"), QUrl(QStringLiteral("delegaterecycler.cpp")));
-        }
-        m_propertiesTracker = (*it)->create(QQmlEngine::contextForObject(this));
-
-        connect(m_propertiesTracker, SIGNAL(trackedIndexChanged()), this, SLOT(syncIndex()));
-        connect(m_propertiesTracker, SIGNAL(trackedModelChanged()), this, SLOT(syncModel()));
-        connect(m_propertiesTracker, SIGNAL(trackedModelDataChanged()), this, SLOT(syncModelData()));
+    if (!m_trackingModel) {
+        trackModel();
     }
 
-    if (m_sourceComponent) {
+    cancelIncubation();
+    if (m_sourceComponent && m_cache) {
         if (m_item) {
             disconnect(m_item.data(), &QQuickItem::implicitWidthChanged, this, &DelegateRecycler::updateHints);
             disconnect(m_item.data(), &QQuickItem::implicitHeightChanged, this, &DelegateRecycler::updateHints);
-            s_delegateCache->insert(component, m_item);
+            m_cache->insert(m_sourceComponent, m_item);
         }
-        s_delegateCache->deref(component);
+        m_cache->deref(m_sourceComponent);
     }
 
     m_sourceComponent = component;
-    s_delegateCache->ref(component);
+    if (!component) {
+        m_item = nullptr;
+        emit sourceComponentChanged();
+        return;
+    }
+
+    m_cache = DelegateCache::instance(qmlEngine(this));
+    m_cache->ref(component);
 
-    m_item = s_delegateCache->take(component);
+    m_item = m_cache->take(component);
 
     if (!m_item) {
         QQuickItem *candidate = parentItem();
@@ -253,64 +794,42 @@ QtObject {
 
         Q_ASSERT(ctx);
 
-        QObject *contextObjectToSet = nullptr;
-        {
-            // Find the first parent that has a context object with a valid translationDomain property, i.e. is a KLocalizedContext
-            QQmlContext *auxCtx = ctx;
-            while (auxCtx != nullptr) {
-                QObject *auxCtxObj = auxCtx->contextObject();
-                if (auxCtxObj && auxCtxObj->property("translationDomain").isValid()) {
-                    contextObjectToSet = auxCtxObj;
-                    break;
-                }
-                auxCtx = auxCtx->parentContext();
-            }
-        }
+        QObject *contextObjectToSet = translationContextObject(ctx);
         if (contextObjectToSet) {
             ctx->setContextObject(contextObjectToSet);
         }
 
-        QObject *modelObj = m_propertiesTracker->property("trackedModel").value<QObject *>();
-        if (modelObj) {
-            const QMetaObject *metaObj = modelObj->metaObject();
-            for (int i = metaObj->propertyOffset(); i < metaObj->propertyCount(); ++i) {
-                QMetaProperty prop = metaObj->property(i);
-                ctx->setContextProperty(QString::fromUtf8(prop.name()), prop.read(modelObj));
-                if (prop.hasNotifySignal()) {
-                    QMetaMethod updateSlot = metaObject()->method(
-                    metaObject()->indexOfSlot("syncModelProperties()"));
-                    connect(modelObj, prop.notifySignal(), this, updateSlot);
-                }
-            }
-        }
+        setModelObject(ctx, trackedProperty(ModelProperty).value<QObject *>());
 
-        ctx->setContextProperty(QStringLiteral("model"), m_propertiesTracker->property("trackedModel"));
-        ctx->setContextProperty(QStringLiteral("modelData"), m_propertiesTracker->property("trackedModelData"));
-        ctx->setContextProperty(QStringLiteral("index"), m_propertiesTracker->property("trackedIndex"));
+        ctx->setContextProperty(QStringLiteral("model"), trackedProperty(ModelProperty));
+        ctx->setContextProperty(QStringLiteral("modelData"), trackedProperty(ModelDataProperty));
+        ctx->setContextProperty(QStringLiteral("index"), trackedProperty(IndexProperty));
         ctx->setContextProperty(QStringLiteral("delegateRecycler"), this);
 
+        // Without an incubation controller nothing would drive the incubator.
+        // Without a size to hold the place of the delegate with, the view would
+        // see an empty delegate and go on creating the ones of the whole model
+        const QSizeF estimate = m_cache->estimatedImplicitSize(component);
+        if (m_asynchronous && qmlEngine(this)->incubationController() && (estimate.width() > 0 || estimate.height() > 0)) {
+            incubateItem(component, ctx);
+            emit sourceComponentChanged();
+            return;
+        }
+
         QObject * obj = component->create(ctx);
         m_item = qobject_cast<QQuickItem *>(obj);
         if (!m_item) {
-            obj->deleteLater();
+            delete obj;
         } else {
             connect(m_item.data(), &QObject::destroyed, ctx, &QObject::deleteLater);
-            //if the user binded an explicit width, consider it, otherwise base upon implicit
-            m_widthFromItem = m_item->width() > 0 && m_item->width() != m_item->implicitWidth();
-            m_heightFromItem = m_item->height() > 0 && m_item->height() != m_item->implicitHeight();
-
-            if (m_widthFromItem && m_heightFromItem) {
-                connect(m_item.data(), &QQuickItem::heightChanged, this, [this]() {
-                    updateSize(false);
-                });
-            }
+            initCreatedItem();
         }
     } else {
         syncModel();
 
         QQmlContext *ctx = QQmlEngine::contextForObject(m_item)->parentContext();
-        ctx->setContextProperties({ QQmlContext::PropertyPair{ QStringLiteral("modelData"), m_propertiesTracker->property("trackedModelData") },
-                                    QQmlContext::PropertyPair{ QStringLiteral("index"), m_propertiesTracker->property("trackedIndex")},
+        ctx->setContextProperties({ QQmlContext::PropertyPair{ QStringLiteral("modelData"), trackedProperty(ModelDataProperty) },
+                                    QQmlContext::PropertyPair{ QStringLiteral("index"), trackedProperty(IndexProperty)},
                                     QQmlContext::PropertyPair{ QStringLiteral("delegateRecycler"), QVariant::fromValue<QObject*>(this) }
                                  });
 
@@ -320,20 +839,96 @@ QtObject {
         }
     }
 
-    if (m_item) {
-        m_item->setParentItem(this);
-        connect(m_item.data(), &QQuickItem::implicitWidthChanged, this, &DelegateRecycler::updateHints);
-        connect(m_item.data(), &QQuickItem::implicitHeightChanged, this, &DelegateRecycler::updateHints);
+    attachItem();
 
-        updateSize(true);
+    emit sourceComponentChanged();
+}
+
+void DelegateRecycler::incubateItem(QQmlComponent *component, QQmlContext *ctx)
+{
+    // Hold the place of the delegate, so the view doesn't have to move everything once it's ready
+    const QSizeF estimate = m_cache->estimatedImplicitSize(component);
+    setImplicitSize(estimate.width(), estimate.height());
+
+    // Kept until the next cancelIncubation(), it can't be deleted from its own callback
+    m_incubator = new DelegateIncubator(ctx, [this, ctx](QQuickItem *item) {
+        if (!item) {
+            ctx->deleteLater();
+            return;
+        }
+
+        connect(item, &QObject::destroyed, ctx, &QObject::deleteLater);
+        m_item = item;
+        initCreatedItem();
+        attachItem();
+    });
+    component->create(*m_incubator, ctx);
+}
+
+void DelegateRecycler::cancelIncubation()
+{
+    if (!m_incubator) {
+        return;
     }
 
-    emit sourceComponentChanged();
+    // Once done, the context belongs to the delegate, or is already deleted
+    if (m_incubator->isLoading()) {
+        QQmlContext *ctx = m_incubator->context();
+        m_incubator->clear();
+        ctx->deleteLater();
+    }
+    delete m_incubator;
+    m_incubator = nullptr;
+}
+
+void DelegateRecycler::initCreatedItem()
+{
+    //if the user binded an explicit width, consider it, otherwise base upon implicit
+    m_widthFromItem = m_item->width() > 0 && m_item->width() != m_item->implicitWidth();
+    m_heightFromItem = m_item->height() > 0 && m_item->height() != m_item->implicitHeight();
+
+    if (m_widthFromItem && m_heightFromItem) {
+        connect(m_item.data(), &QQuickItem::heightChanged, this, [this]() {
+            updateSize(false);
+        });
+    }
+
+    m_cache->setImplicitSize(m_sourceComponent, QSizeF(m_item->implicitWidth(), m_item->implicitHeight()));
+}
+
+void DelegateRecycler::attachItem()
+{
+    if (!m_item) {
+        return;
+    }
+
+    m_item->setParentItem(this);
+    connect(m_item.data(), &QQuickItem::implicitWidthChanged, this, &DelegateRecycler::updateHints);
+    connect(m_item.data(), &QQuickItem::implicitHeightChanged, this, &DelegateRecycler::updateHints);
+
+    updateSize(true);
+}
+
+bool DelegateRecycler::isAsynchronous() const
+{
+    return m_asynchronous;
+}
+
+void DelegateRecycler::setAsynchronous(bool asynchronous)
+{
+    if (asynchronous == m_asynchronous) {
+        return;
+    }
+
+    m_asynchronous = asynchronous;
+    emit asynchronousChanged();
 }
 
 void DelegateRecycler::resetSourceComponent()
 {
-    s_delegateCache->deref(m_sourceComponent);
+    if (m_sourceComponent && m_cache) {
+        m_cache->deref(m_sourceComponent);
+    }
     m_sourceComponent = nullptr;
 }
 
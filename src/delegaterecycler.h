@@ -11,6 +11,10 @@
 #include <QVariant>
 #include <QPointer>
 
+class DelegateCache;
+class DelegateIncubator;
+class QQmlContext;
+class QQmlEngine;
 
 
 class DelegateRecyclerAttached : public QObject
@@ -57,6 +61,22 @@ class DelegateRecycler : public QQuickItem
      */
     Q_PROPERTY(QQmlComponent *sourceComponent READ sourceComponent WRITE setSourceComponent RESET resetSourceComponent NOTIFY sourceComponentChanged)
 
+    /**
+     * When true, delegates which can't be taken from the pool are created
+     * incrementally over several frames instead of all at once.
+     *
+     * Until the delegate is ready, the DelegateRecycler keeps the implicit size
+     * the last delegate made from the same component had. The first delegate of
+     * a component is created at once, so there is a size to keep. This is meant for
+     * heavy delegates, so flicking quickly through a list doesn't stall on the
+     * frames creating many of them.
+     *
+     * default: ``false``
+     *
+     * @since 2.15
+     */
+    Q_PROPERTY(bool asynchronous READ isAsynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
+
 public:
     DelegateRecycler(QQuickItem *parent = nullptr);
     ~DelegateRecycler();
@@ -66,6 +86,9 @@ public:
     void setSourceComponent(QQmlComponent *component);
     void resetSourceComponent();
 
+    bool isAsynchronous() const;
+    void setAsynchronous(bool asynchronous);
+
     static DelegateRecyclerAttached *qmlAttachedProperties(QObject *object);
 
 protected:
@@ -77,6 +100,7 @@ protected:
 
 Q_SIGNALS:
     void sourceComponentChanged();
+    void asynchronousChanged();
 
 private Q_SLOTS:
     void syncIndex();
@@ -85,14 +109,112 @@ private Q_SLOTS:
     void syncModelData();
 
 private:
+    enum TrackedProperty {
+        IndexProperty,
+        ModelProperty,
+        ModelDataProperty,
+    };
+
+    void trackModel();
+    QVariant trackedProperty(TrackedProperty property) const;
+    void setModelObject(QQmlContext *ctx, QObject *modelObj);
+    QQmlContext *delegateContext() const;
+    void incubateItem(QQmlComponent *component, QQmlContext *ctx);
+    void cancelIncubation();
+    void initCreatedItem();
+    void attachItem();
+
     QPointer<QQmlComponent> m_sourceComponent;
+    QPointer<DelegateCache> m_cache;
     QPointer<QQuickItem> m_item;
-    QObject *m_propertiesTracker = nullptr;
+    // The model object whose properties are in the context of the delegate
+    QPointer<QObject> m_modelObject;
+    DelegateIncubator *m_incubator = nullptr;
+    bool m_trackingModel = false;
+    bool m_asynchronous = false;
     bool m_updatingSize = false;
     bool m_widthFromItem = false;
     bool m_heightFromItem = false;
 };
 
+/**
+ * Gives access to the delegates DelegateRecyclers of the engine keep around for reuse.
+ *
+ * Every component gets a pool as big as the most delegates of it which were alive
+ * at the same time, which shrinks again when it isn't reused for a while.
+ *
+ * @code{.qml}
+ * Component.onCompleted: {
+ *     Kirigami.DelegateRecyclerCache.memoryBudget = 4 * 1024 * 1024
+ * }
+ * @endcode
+ *
+ * @since 2.15
+ */
+class DelegateRecyclerCache : public QObject
+{
+    Q_OBJECT
+
+    /**
+     * The memory pooled delegates can use, in bytes.
+     *
+     * The memory used by a delegate is estimated from the number of objects in it.
+     * When over budget, delegates of the components least recently used are deleted first.
+     *
+     * default: 16 MiB, or the amount of MiB in the KIRIGAMI_DELEGATE_CACHE_BUDGET
+     * environment variable
+     */
+    Q_PROPERTY(qint64 memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY memoryBudgetChanged)
+
+public:
+    explicit DelegateRecyclerCache(QQmlEngine *engine, QObject *parent = nullptr);
+
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+    /**
+     * Creates @p count delegates of @p component ahead of time, so the
+     * DelegateRecyclers using it find them ready the first time a list scrolls.
+     *
+     * Delegates are created one after the other, incrementally in the idle time
+     * between frames, and stay pooled until the component is first used, as long
+     * as the memory budget allows.
+     *
+     * Until a DelegateRecycler takes them, prewarmed delegates have an empty object
+     * as model, so all its roles are undefined, an undefined modelData and -1 as
+     * index: their bindings must cope with that, for instance with
+     * `text: model.title || ""`.
+     *
+     * @code{.qml}
+     * Kirigami.ScrollablePage {
+     *     Component.onCompleted: Kirigami.DelegateRecyclerCache.prewarm(settingDelegate, 12)
+     *     ListView {
+     *         delegate: Kirigami.DelegateRecycler {
+     *             sourceComponent: settingDelegate
+     *         }
+     *     }
+     *     Component {
+     *         id: settingDelegate
+     *         ...
+     *     }
+     * }
+     * @endcode
+     */
+    Q_INVOKABLE void prewarm(QQmlComponent *component, int count);
+
+    /**
+     * @returns the counters of the cache activity: "hits", "misses", "evictions",
+     * "pooledItems" and the estimated "pooledBytes" they use.
+     */
+    Q_INVOKABLE QVariantMap statistics() const;
+
+Q_SIGNALS:
+    void memoryBudgetChanged();
+
+private:
+    QPointer<QQmlEngine> m_engine;
+};
+
 QML_DECLARE_TYPEINFO(DelegateRecycler, QML_HAS_ATTACHED_PROPERTIES)
 
 #endif
@@ -21,11 +21,573 @@
 #include <QGuiApplication>
 #include <QPainter>
 #include <QScreen>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <vector>
 
 
 
 Q_GLOBAL_STATIC(ImageTexturesCache, s_iconImageCache)
 
+// Rasterized and tinted icons, shared by all the instances showing an icon in the same way,
+// so they also share the same texture. The cost of every entry is its size in KiB
+typedef QCache<QString, QImage> IconRasterCache;
+Q_GLOBAL_STATIC_WITH_ARGS(IconRasterCache, s_iconRasterCache, (16 * 1024))
+
+// Threads rendering the icons of asynchronous Icons, kept apart from the global pool
+class IconThreadPool : public QThreadPool
+{
+public:
+    IconThreadPool()
+    {
+        setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    }
+};
+
+Q_GLOBAL_STATIC(IconThreadPool, s_iconPool)
+
+static bool isSymbolicIconName(const QString &name)
+{
+    return name.endsWith(QLatin1String("-symbolic"))
+        || name.endsWith(QLatin1String("-symbolic-rtl"))
+        || name.endsWith(QLatin1String("-symbolic-ltr"));
+}
+
+// Whether icons look monochrome, by icon name, size and mode, see Icon::guessMonochrome
+Q_GLOBAL_STATIC(QHash<QString, bool>, s_monochromeHeuristics)
+
+// x * log(x) for the pixel counts of icons up to 64x64, a bigger icon is the exception
+static const int s_entropyTableSize = 64 * 64 + 1;
+
+static float countEntropy(int count)
+{
+    static const std::vector<float> table = []() {
+        std::vector<float> table(s_entropyTableSize);
+        table[0] = 0;
+        for (int i = 1; i < s_entropyTableSize; ++i) {
+            table[i] = i * std::log(float(i));
+        }
+        return table;
+    }();
+
+    return count < s_entropyTableSize ? table[count] : count * std::log(float(count));
+}
+
+// Arbitrarly low values of entropy of the gray levels and of saturated pixels
+static bool isMonochrome(const QImage &source)
+{
+    const QImage img = source.format() == QImage::Format_ARGB32_Premultiplied
+        ? source : source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    int histogram[256] = {};
+    int transparentPixels = 0;
+    int saturatedPixels = 0;
+    for (int y = 0; y < img.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(img.constScanLine(y));
+        for (int x = 0; x < img.width(); ++x) {
+            const QRgb pixel = qUnpremultiply(line[x]);
+            if (qAlpha(pixel) < 100) {
+                ++transparentPixels;
+                continue;
+            }
+            // Same as QColor::saturation() > 84, without the conversion to HSV
+            const int max = qMax(qRed(pixel), qMax(qGreen(pixel), qBlue(pixel)));
+            const int min = qMin(qRed(pixel), qMin(qGreen(pixel), qBlue(pixel)));
+            if (max > 0 && 2 * 65535 * (max - min) >= 43519 * max) {
+                ++saturatedPixels;
+            }
+            ++histogram[qGray(pixel)];
+        }
+    }
+
+    const int opaquePixels = img.width() * img.height() - transparentPixels;
+    if (opaquePixels == 0) {
+        return true;
+    }
+
+    // -sum(p * log(p)) with p = count / total is log(total) - sum(count * log(count)) / total
+    qreal countsEntropy = 0;
+    for (int count : histogram) {
+        countsEntropy += countEntropy(count);
+    }
+    const qreal entropy = (std::log(qreal(opaquePixels)) - countsEntropy / opaquePixels) / std::log(255.0);
+
+    return saturatedPixels <= opaquePixels * 0.3 && entropy <= 0.3;
+}
+
+/**
+ * Remote icons, decoded at the size they are shown at and kept on disk, so
+ * later sessions can map them in memory rather than download and decode them
+ * again.
+ *
+ * Used from worker threads.
+ */
+class RemoteIconCache
+{
+public:
+    // Null if not cached, or downloaded too long ago: the image at the url may have changed since
+    static QImage load(const QUrl &url, const QSize &size)
+    {
+        QScopedPointer<QFile> file(new QFile(diskPath(url, size)));
+        if (!file->open(QIODevice::ReadOnly) || file->size() < qint64(sizeof(Header))) {
+            return QImage();
+        }
+
+        const uchar *data = file->map(0, file->size());
+        if (!data) {
+            return QImage();
+        }
+
+        // Keeps the icons still in use at the front when pruning
+        file->setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+        Header header;
+        std::memcpy(&header, data, sizeof(Header));
+        if (header.magic != s_magic || header.version != s_version
+            || header.width <= 0 || header.height <= 0 || header.bytesPerLine < header.width * 4
+            || file->size() != qint64(sizeof(Header)) + qint64(header.bytesPerLine) * header.height
+            || QDateTime::fromMSecsSinceEpoch(header.downloaded).daysTo(QDateTime::currentDateTime()) >= s_maximumFreshDays) {
+            return QImage();
+        }
+
+        // The mapping lives as long as the file, which lives as long as the image
+        return QImage(data + sizeof(Header), header.width, header.height, header.bytesPerLine,
+                      QImage::Format_ARGB32_Premultiplied,
+                      [](void *file) { delete static_cast<QFile *>(file); }, file.take());
+    }
+
+    static void save(const QUrl &url, const QSize &size, const QImage &image)
+    {
+        Q_ASSERT(image.format() == QImage::Format_ARGB32_Premultiplied);
+
+        // Saves happen in worker threads, only one of them gets to prune
+        static QBasicAtomicInt pruned = Q_BASIC_ATOMIC_INITIALIZER(0);
+        if (pruned.testAndSetRelaxed(0, 1)) {
+            prune();
+        }
+
+        const QString path = diskPath(url, size);
+        QDir().mkpath(QFileInfo(path).absolutePath());
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return;
+        }
+
+        Header header;
+        header.downloaded = QDateTime::currentMSecsSinceEpoch();
+        header.width = image.width();
+        header.height = image.height();
+        header.bytesPerLine = image.bytesPerLine();
+        file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        file.write(reinterpret_cast<const char *>(image.constBits()), image.sizeInBytes());
+
+        file.commit();
+    }
+
+private:
+    // Followed by the pixels, in the native QImage::Format_ARGB32_Premultiplied layout
+    struct Header {
+        quint32 magic = s_magic;
+        quint32 version = s_version;
+        // When the image was downloaded, in milliseconds since the epoch
+        qint64 downloaded = 0;
+        qint32 width = 0;
+        qint32 height = 0;
+        qint32 bytesPerLine = 0;
+        quint32 reserved = 0;
+    };
+
+    static const quint32 s_magic = 0x4b49524b;
+    static const quint32 s_version = 2;
+
+    // Icons are downloaded again after this long, no matter how often they are shown
+    static const int s_maximumFreshDays = 7;
+
+    // Limits of the disk cache, enforced once per process before the first icon is saved
+    static const qint64 s_maximumDiskSize = 32 * 1024 * 1024;
+    static const int s_maximumAgeDays = 30;
+
+    static QString diskDirectory()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/kirigami/icons");
+    }
+
+    // Drops the icons not shown for too long, then the least recently shown ones over the size limit
+    static void prune()
+    {
+        const QDateTime expiry = QDateTime::currentDateTime().addDays(-s_maximumAgeDays);
+        const QFileInfoList entries = QDir(diskDirectory()).entryInfoList(QDir::Files, QDir::Time);
+        qint64 size = 0;
+        for (const QFileInfo &entry : entries) {
+            if (entry.lastModified() < expiry || size + entry.size() > s_maximumDiskSize) {
+                QFile::remove(entry.absoluteFilePath());
+            } else {
+                size += entry.size();
+            }
+        }
+    }
+
+    static QString diskPath(const QUrl &url, const QSize &size)
+    {
+        return diskDirectory() + QLatin1Char('/')
+            + QString::fromLatin1(QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Md5).toHex())
+            + QLatin1Char('-') + QString::number(size.width()) + QLatin1Char('x') + QString::number(size.height());
+    }
+};
+
+// Runs in a worker thread: decodes a downloaded image directly at the size it's shown at
+static QImage decodeRemoteIcon(const QByteArray &data, const QUrl &url, const QSize &size)
+{
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer);
+    const QSize imageSize = reader.size();
+    if (imageSize.isValid() && (imageSize.width() > size.width() || imageSize.height() > size.height())) {
+        reader.setScaledSize(imageSize.scaled(size, Qt::KeepAspectRatio));
+    }
+
+    const QImage image = reader.read().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    if (!image.isNull()) {
+        RemoteIconCache::save(url, size, image);
+    }
+    return image;
+}
+
+/**
+ * Loads of remote and provided images in progress: Icons asking for the same
+ * image at the same size share a single request, and the resulting image.
+ */
+class IconRequests
+{
+public:
+    static QString key(QQmlEngine *engine, const QString &source, const QSize &size)
+    {
+        return QString::number(quintptr(engine)) + QLatin1Char('|') + source
+            + QLatin1Char('|') + QString::number(size.width()) + QLatin1Char('x') + QString::number(size.height());
+    }
+
+    /**
+     * Adds @p icon to the ones waiting for @p key.
+     *
+     * @returns true if nobody else was waiting for it, the caller then needs to start loading it
+     */
+    bool join(const QString &key, Icon *icon)
+    {
+        auto it = m_waiting.find(key);
+        if (it == m_waiting.end()) {
+            m_waiting.insert(key, {QPointer<Icon>(icon)});
+            return true;
+        }
+        if (!it->contains(icon)) {
+            it->append(icon);
+        }
+        return false;
+    }
+
+    // Looks up the disk cache in a worker thread, then downloads the image if it isn't there
+    void fetch(QNetworkAccessManager *qnam, const QString &source, const QSize &size, const QString &key)
+    {
+        QPointer<QNetworkAccessManager> guardedQnam(qnam);
+        auto watcher = new QFutureWatcher<QImage>();
+        QObject::connect(watcher, &QFutureWatcher<QImage>::finished, watcher, [this, watcher, guardedQnam, source, size, key]() {
+            watcher->deleteLater();
+            const QImage image = watcher->result();
+            if (!image.isNull() || !guardedQnam) {
+                finish(key, source, size, image);
+            } else {
+                get(guardedQnam, QUrl(source), source, size, key);
+            }
+        });
+        watcher->setFuture(QtConcurrent::run(s_iconPool(), RemoteIconCache::load, QUrl(source), size));
+    }
+
+    void requestResponse(QQuickAsyncImageProvider *provider, const QString &id, const QSize &requestedSize, const QString &key, const QString &source)
+    {
+        QQuickImageResponse *response = provider->requestImageResponse(id, requestedSize);
+        // Responses can finish in any thread
+        QObject::connect(response, &QQuickImageResponse::finished, qApp, [this, response, key, source, requestedSize]() {
+            QImage image;
+            if (response->errorString().isEmpty()) {
+                QScopedPointer<QQuickTextureFactory> textureFactory(response->textureFactory());
+                if (textureFactory) {
+                    image = textureFactory->image();
+                }
+            }
+            response->deleteLater();
+            finish(key, source, requestedSize, image);
+        });
+    }
+
+private:
+    // Remote images are cached under the url of the source, not the one it may redirect to
+    void get(QNetworkAccessManager *qnam, const QUrl &url, const QString &source, const QSize &size, const QString &key)
+    {
+        QNetworkRequest request(url);
+        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+        QNetworkReply *reply = qnam->get(request);
+        QObject::connect(reply, &QNetworkReply::finished, reply, [this, qnam, reply, source, size, key]() {
+            reply->deleteLater();
+
+            const QUrl possibleRedirectUrl = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+            if (!possibleRedirectUrl.isEmpty()) {
+                const QUrl redirectUrl = reply->url().resolved(possibleRedirectUrl);
+                // no infinite redirections thank you very much
+                if (reply->error() != QNetworkReply::NoError || redirectUrl == reply->url()) {
+                    finish(key, source, size, QImage());
+                } else {
+                    get(qnam, redirectUrl, source, size, key);
+                }
+                return;
+            }
+
+            auto watcher = new QFutureWatcher<QImage>();
+            QObject::connect(watcher, &QFutureWatcher<QImage>::finished, watcher, [this, watcher, source, size, key]() {
+                watcher->deleteLater();
+                finish(key, source, size, watcher->result());
+            });
+            watcher->setFuture(QtConcurrent::run(s_iconPool(), decodeRemoteIcon, reply->readAll(), QUrl(source), size));
+        });
+    }
+
+    void finish(const QString &key, const QString &source, const QSize &size, const QImage &image)
+    {
+        const QList<QPointer<Icon>> waiting = m_waiting.take(key);
+        for (const QPointer<Icon> &icon : waiting) {
+            if (icon) {
+                icon->handleLoadedImage(source, size, image);
+            }
+        }
+    }
+
+    QHash<QString, QList<QPointer<Icon>>> m_waiting;
+};
+
+Q_GLOBAL_STATIC(IconRequests, s_iconRequests)
+
+// Turns qrc and file urls into paths QIcon understands
+static QString localIconSource(const QString &source)
+{
+    if (source.startsWith(QLatin1String("qrc:/"))) {
+        return source.mid(3);
+    } else if (source.startsWith(QLatin1String("file:/"))) {
+        return QUrl(source).path();
+    }
+    return source;
+}
+
+/**
+ * Finds the files of theme icons the way QIcon does, following the freedesktop
+ * icon theme specification, so they can be decoded in a worker thread.
+ *
+ * Only used in the GUI thread.
+ */
+class IconThemeFiles
+{
+public:
+    // Empty if the theme has no such icon, or not in a format QImageReader knows
+    QString find(const QString &name, int size)
+    {
+        const QString key = QIcon::themeName() + QLatin1Char('|') + name + QLatin1Char('|') + QString::number(size);
+        auto it = m_paths.constFind(key);
+        if (it != m_paths.constEnd()) {
+            return it.value();
+        }
+
+        QSet<QString> visited;
+        QString path = lookup(name, size, QIcon::themeName(), visited);
+        if (path.isEmpty()) {
+            path = lookup(name, size, QIcon::fallbackThemeName(), visited);
+        }
+        if (path.isEmpty()) {
+            path = lookup(name, size, QStringLiteral("hicolor"), visited);
+        }
+        m_paths.insert(key, path);
+        return path;
+    }
+
+private:
+    struct Directory {
+        enum Type {
+            Fixed,
+            Scalable,
+            Threshold
+        };
+        QString path;
+        Type type = Threshold;
+        int size = 0;
+        int minSize = 0;
+        int maxSize = 0;
+        int threshold = 2;
+    };
+
+    struct Theme {
+        // The directory of the theme in every search path which has one
+        QStringList baseDirs;
+        QVector<Directory> directories;
+        QStringList parents;
+    };
+
+    const Theme &loadTheme(const QString &name)
+    {
+        auto it = m_themes.find(name);
+        if (it != m_themes.end()) {
+            return it.value();
+        }
+
+        Theme theme;
+        QString indexPath;
+        const QStringList searchPaths = QIcon::themeSearchPaths();
+        for (const QString &searchPath : searchPaths) {
+            const QString baseDir = searchPath + QLatin1Char('/') + name;
+            if (!QFileInfo(baseDir).isDir()) {
+                continue;
+            }
+            theme.baseDirs << baseDir;
+            if (indexPath.isEmpty() && QFileInfo::exists(baseDir + QStringLiteral("/index.theme"))) {
+                indexPath = baseDir + QStringLiteral("/index.theme");
+            }
+        }
+
+        if (!indexPath.isEmpty()) {
+            const QSettings index(indexPath, QSettings::IniFormat);
+            theme.parents = index.value(QStringLiteral("Icon Theme/Inherits")).toStringList();
+            const QStringList directories = index.value(QStringLiteral("Icon Theme/Directories")).toStringList();
+            for (const QString &path : directories) {
+                // Directories for high DPI screens hold the same icons, the size asked for is in device pixels
+                if (index.value(path + QStringLiteral("/Scale"), 1).toInt() != 1) {
+                    continue;
+                }
+                Directory directory;
+                directory.path = path;
+                directory.size = index.value(path + QStringLiteral("/Size")).toInt();
+                directory.minSize = index.value(path + QStringLiteral("/MinSize"), directory.size).toInt();
+                directory.maxSize = index.value(path + QStringLiteral("/MaxSize"), directory.size).toInt();
+                directory.threshold = index.value(path + QStringLiteral("/Threshold"), 2).toInt();
+                const QString type = index.value(path + QStringLiteral("/Type")).toString();
+                if (type == QLatin1String("Fixed")) {
+                    directory.type = Directory::Fixed;
+                } else if (type == QLatin1String("Scalable")) {
+                    directory.type = Directory::Scalable;
+                }
+                if (directory.size > 0) {
+                    theme.directories << directory;
+                }
+            }
+        }
+
+        return m_themes.insert(name, theme).value();
+    }
+
+    static int sizeDistance(const Directory &directory, int size)
+    {
+        switch (directory.type) {
+        case Directory::Fixed:
+            return qAbs(directory.size - size);
+        case Directory::Scalable:
+            return size < directory.minSize ? directory.minSize - size : qMax(0, size - directory.maxSize);
+        case Directory::Threshold:
+            if (size < directory.size - directory.threshold) {
+                return directory.minSize - size;
+            }
+            return size > directory.size + directory.threshold ? size - directory.maxSize : 0;
+        }
+        return 0;
+    }
+
+    // The icon in the directory matching the size, or else in the closest one
+    QString lookup(const QString &name, int size, const QString &themeName, QSet<QString> &visited)
+    {
+        if (themeName.isEmpty() || visited.contains(themeName)) {
+            return QString();
+        }
+        visited.insert(themeName);
+
+        // Copied, loading the parents below can rehash m_themes
+        const Theme theme = loadTheme(themeName);
+        static const QString extensions[] = {QStringLiteral(".svg"), QStringLiteral(".svgz"), QStringLiteral(".png")};
+
+        QString closest;
+        int closestDistance = INT_MAX;
+        for (const Directory &directory : theme.directories) {
+            const int distance = sizeDistance(directory, size);
+            if (distance >= closestDistance) {
+                continue;
+            }
+            for (const QString &baseDir : theme.baseDirs) {
+                for (const QString &extension : extensions) {
+                    const QString path = baseDir + QLatin1Char('/') + directory.path + QLatin1Char('/') + name + extension;
+                    if (QFileInfo::exists(path)) {
+                        if (distance == 0) {
+                            return path;
+                        }
+                        closest = path;
+                        closestDistance = distance;
+                        break;
+                    }
+                }
+                if (closestDistance == distance) {
+                    break;
+                }
+            }
+        }
+        if (!closest.isEmpty()) {
+            return closest;
+        }
+
+        for (const QString &parent : theme.parents) {
+            const QString path = lookup(name, size, parent, visited);
+            if (!path.isEmpty()) {
+                return path;
+            }
+        }
+        return QString();
+    }
+
+    QHash<QString, Theme> m_themes;
+    // By theme, icon name and size
+    QHash<QString, QString> m_paths;
+};
+
+Q_GLOBAL_STATIC(IconThemeFiles, s_iconThemeFiles)
+
+// Runs in a worker thread: only decodes a local file into a QImage, as neither
+// the icon theme lookup nor QPixmap are safe to use outside of the GUI thread
+static QImage decodeIconFile(const QString &path, const QSize &size)
+{
+    QThread::currentThread()->setPriority(QThread::LowPriority);
+
+    QImageReader reader(path);
+    const QSize imageSize = reader.size();
+    // Vector images are rendered at the requested size, bitmaps are only scaled down, like QIcon does
+    const bool vector = reader.format().startsWith("svg");
+    if (imageSize.isValid() && (vector || imageSize.width() > size.width() || imageSize.height() > size.height())) {
+        reader.setScaledSize(imageSize.scaled(size, Qt::KeepAspectRatio));
+    }
+    return reader.read().convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
 Icon::Icon(QQuickItem *parent)
     : QQuickItem(parent),
       m_changed(false),
@@ -54,6 +616,7 @@ void Icon::setSource(const QVariant &icon)
     }
     m_source = icon;
     m_monochromeHeuristics.clear();
+    m_failedKeys.clear();
 
     if (!m_theme) {
         m_theme = static_cast<Kirigami::PlatformTheme *>(qmlAttachedPropertiesObject<Kirigami::PlatformTheme>(this, true));
@@ -63,18 +626,15 @@ void Icon::setSource(const QVariant &icon)
     }
 
     if (icon.type() == QVariant::String) {
-        const QString iconSource = icon.toString();
-        m_isMaskHeuristic = (iconSource.endsWith(QLatin1String("-symbolic"))
-                            || iconSource.endsWith(QLatin1String("-symbolic-rtl"))
-                            || iconSource.endsWith(QLatin1String("-symbolic-ltr")));
+        m_isMaskHeuristic = isSymbolicIconName(icon.toString());
         emit isMaskChanged();
     }
 
-    if (m_networkReply) {
-        //if there was a network query going on, interrupt it
-        m_networkReply->close();
-    }
+    // A load still going on for the previous source is shared with other Icons, its result just gets ignored
     m_loadedImage = QImage();
+    m_loadedSize = QSize();
+    m_remoteLoading = false;
+    m_loadFailed = false;
     setStatus(Loading);
 
     polish();
@@ -180,7 +740,7 @@ QSGNode* Icon::updatePaintNode(QSGNode* node, QQuickItem::UpdatePaintNodeData* /
         if (itemSize.width() != 0 && itemSize.height() != 0) {
             const auto multiplier = QCoreApplication::instance()->testAttribute(Qt::AA_UseHighDpiPixmaps) ? 1 : (window() ? window()->devicePixelRatio() : qGuiApp->devicePixelRatio());
             const QSize size = itemSize * multiplier;
-            mNode->setTexture(s_iconImageCache->loadTexture(window(), m_icon));
+            mNode->setTexture(s_iconImageCache->loadTexture(window(), m_icon, QQuickWindow::TextureCanUseAtlas));
             if (m_icon.size() != size) {
                 // At this point, the image will already be scaled, but we need to output it in
                 // the correct aspect ratio, painted centered in the viewport. So:
@@ -208,47 +768,22 @@ void Icon::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
     }
 }
 
-void Icon::handleRedirect(QNetworkReply* reply)
+void Icon::handleLoadedImage(const QString &source, const QSize &size, const QImage &image)
 {
-    QNetworkAccessManager* qnam = reply->manager();
-    if (reply->error() != QNetworkReply::NoError) {
+    if (source != m_source.toString()) {
         return;
     }
-    const QUrl possibleRedirectUrl = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
-    if (!possibleRedirectUrl.isEmpty()) {
-        const QUrl redirectUrl = reply->url().resolved(possibleRedirectUrl);
-        if (redirectUrl == reply->url()) {
-            // no infinite redirections thank you very much
-            reply->deleteLater();
-            return;
-        }
-        reply->deleteLater();
-        QNetworkRequest request(possibleRedirectUrl);
-        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
-        m_networkReply = qnam->get(request);
-        connect(m_networkReply.data(), &QNetworkReply::finished, this, [this](){
-            if (m_networkReply)
-                handleFinished(m_networkReply);
-        });
-    }
-}
-
-void Icon::handleFinished(QNetworkReply* reply)
-{
-    reply->deleteLater();
-    if (!reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isNull()) {
-        handleRedirect(reply);
-        return;
-    }
-
-    m_loadedImage = QImage();
 
-    const QString filename = reply->url().fileName();
-    if (!m_loadedImage.load(reply, filename.mid(filename.indexOf(QLatin1Char('.'))).toLatin1().constData())) {
-        qWarning() << "received broken image" << reply->url();
+    m_remoteLoading = false;
+    m_loadedImage = image;
+    m_loadedSize = size;
+    m_loadFailed = m_loadedImage.isNull();
+    if (m_loadFailed) {
+        qWarning() << "received broken image" << source;
 
         // broken image from data, inform the user of this with some useful broken-image thing...
         m_loadedImage = QIcon::fromTheme(m_fallback).pixmap(window(), QSize(width(), height()), iconMode(), QIcon::On).toImage();
+        setStatus(Error);
     }
     polish();
 }
@@ -268,6 +803,32 @@ void Icon::updatePolish()
     if (itemSize.width() != 0 && itemSize.height() != 0) {
         const auto multiplier = QCoreApplication::instance()->testAttribute(Qt::AA_UseHighDpiPixmaps) ? 1 : (window() ? window()->devicePixelRatio() : qGuiApp->devicePixelRatio());
         const QSize size = itemSize * multiplier;
+        const QColor tintColor = !m_color.isValid() || m_color == Qt::transparent ? (m_selected ? m_theme->highlightedTextColor() : m_theme->textColor()) : m_color;
+
+        const QString cacheKey = rasterCacheKey(m_source, size, tintColor, isMask());
+        const QImage *cached = cacheKey.isEmpty() ? nullptr : s_iconRasterCache->object(cacheKey);
+        if (cached) {
+            m_icon = *cached;
+            setStatus(Ready);
+            m_changed = true;
+            updatePaintedGeometry();
+            update();
+            return;
+        }
+
+        // Icons which fail to load asynchronously go through the normal path, which takes care of the fallback
+        if (m_asynchronous && !cacheKey.isEmpty() && !m_failedKeys.contains(cacheKey)
+            && (m_source.type() == QVariant::String || m_source.type() == QVariant::Url)
+            && loadAsynchronously(m_source.toString(), cacheKey, size, tintColor, isMask())) {
+            // Keep showing the previous image while resizing or changing state, the placeholder otherwise
+            if (m_status != Ready || m_icon.isNull()) {
+                m_icon = QIcon::fromTheme(m_placeholder).pixmap(window(), size, iconMode(), QIcon::On).toImage();
+            }
+            m_changed = true;
+            updatePaintedGeometry();
+            update();
+            return;
+        }
 
         switch(m_source.type()){
         case QVariant::Pixmap:
@@ -281,6 +842,10 @@ void Icon::updatePolish()
             break;
         case QVariant::Icon:
             m_icon = m_source.value<QIcon>().pixmap(window(), itemSize, iconMode(), QIcon::On).toImage();
+            // Nothing to wait for, and it makes the raster cache below remember it
+            if (!m_icon.isNull()) {
+                setStatus(Ready);
+            }
             break;
         case QVariant::Url:
         case QVariant::String:
@@ -301,14 +866,16 @@ void Icon::updatePolish()
             m_icon.fill(Qt::transparent);
         }
 
-        const QColor tintColor = !m_color.isValid() || m_color == Qt::transparent ? (m_selected ? m_theme->highlightedTextColor() : m_theme->textColor()) : m_color;
-
         //TODO: initialize m_isMask with icon.isMask()
-        if (tintColor.alpha() > 0 && (isMask() || guessMonochrome(m_icon))) {
-            QPainter p(&m_icon);
-            p.setCompositionMode(QPainter::CompositionMode_SourceIn);
-            p.fillRect(m_icon.rect(), tintColor);
-            p.end();
+        // What is shown while loading or after failing to says nothing about the icon
+        const bool loaded = (m_source.type() != QVariant::String && m_source.type() != QVariant::Url) || m_status == Ready;
+        if (tintColor.alpha() > 0 && (isMask() || guessMonochrome(m_icon, m_source, iconMode(), loaded))) {
+            tint(m_icon, tintColor);
+        }
+
+        // Don't remember fallbacks, the real icon may show up later
+        if (!cacheKey.isEmpty() && m_status == Ready) {
+            s_iconRasterCache->insert(cacheKey, new QImage(m_icon), qMax(1, int(m_icon.sizeInBytes() / 1024)));
         }
     }
     m_changed = true;
@@ -316,6 +883,128 @@ void Icon::updatePolish()
     update();
 }
 
+void Icon::tint(QImage &image, const QColor &tintColor)
+{
+    QPainter p(&image);
+    p.setCompositionMode(QPainter::CompositionMode_SourceIn);
+    p.fillRect(image.rect(), tintColor);
+    p.end();
+}
+
+bool Icon::loadAsynchronously(const QString &source, const QString &cacheKey, const QSize &size, const QColor &tintColor, bool mask)
+{
+    if (m_pendingKeys.contains(cacheKey)) {
+        return true;
+    }
+
+    QString path = localIconSource(source);
+    if (!path.contains(QLatin1String("/"))) {
+        // Platform themes colouring icons render them themselves, in the GUI thread
+        if (m_theme->supportsIconColoring()) {
+            return false;
+        }
+        path = s_iconThemeFiles->find(path, qMax(size.width(), size.height()));
+        if (path.isEmpty()) {
+            return false;
+        }
+    }
+
+    m_pendingKeys.insert(cacheKey);
+
+    const QIcon::Mode mode = iconMode();
+    auto watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, this, [this, watcher, source, cacheKey, tintColor, mask, mode]() {
+        m_pendingKeys.remove(cacheKey);
+        QImage image = watcher->result();
+        watcher->deleteLater();
+
+        if (image.isNull()) {
+            m_failedKeys.insert(cacheKey);
+        } else {
+            // The disabled, active and selected looks come from the style, which lives in the GUI thread
+            if (mode != QIcon::Normal) {
+                image = QIcon(QPixmap::fromImage(image)).pixmap(image.size(), mode, QIcon::On).toImage();
+            }
+            if (tintColor.alpha() > 0 && (mask || guessMonochrome(image, source, mode, true))) {
+                tint(image, tintColor);
+            }
+            s_iconRasterCache->insert(cacheKey, new QImage(image), qMax(1, int(image.sizeInBytes() / 1024)));
+        }
+
+        if (source == m_source.toString()) {
+            polish();
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(s_iconPool(), decodeIconFile, path, size));
+
+    return true;
+}
+
+void Icon::preload(const QStringList &sources)
+{
+    const QSize itemSize(width(), height());
+    if (!m_theme || itemSize.isEmpty()) {
+        return;
+    }
+
+    const auto multiplier = QCoreApplication::instance()->testAttribute(Qt::AA_UseHighDpiPixmaps) ? 1 : (window() ? window()->devicePixelRatio() : qGuiApp->devicePixelRatio());
+    const QSize size = itemSize * multiplier;
+    const QColor tintColor = !m_color.isValid() || m_color == Qt::transparent ? (m_selected ? m_theme->highlightedTextColor() : m_theme->textColor()) : m_color;
+
+    for (const QString &source : sources) {
+        const bool mask = m_isMask || isSymbolicIconName(source);
+        const QString cacheKey = rasterCacheKey(source, size, tintColor, mask);
+        if (cacheKey.isEmpty() || s_iconRasterCache->contains(cacheKey)) {
+            continue;
+        }
+        loadAsynchronously(source, cacheKey, size, tintColor, mask);
+    }
+}
+
+QString Icon::rasterCacheKey(const QVariant &iconSource, const QSize &size, const QColor &tintColor, bool mask) const
+{
+    QString source;
+    switch (iconSource.type()) {
+    case QVariant::Icon:
+        source = QStringLiteral("qicon:") + QString::number(iconSource.value<QIcon>().cacheKey());
+        break;
+    case QVariant::Url:
+    case QVariant::String:
+        source = iconSource.toString();
+        // Remote and provided images can change at any time, they are never shared
+        if (source.startsWith(QLatin1String("image://"))
+            || source.startsWith(QLatin1String("http://"))
+            || source.startsWith(QLatin1String("https://"))) {
+            return QString();
+        }
+        break;
+    default:
+        return QString();
+    }
+
+    const qreal devicePixelRatio = window() ? window()->devicePixelRatio() : qGuiApp->devicePixelRatio();
+
+    // Platform themes coloring icons use the whole palette of the item, not only the tint color
+    QString palette;
+    if (m_theme->supportsIconColoring()) {
+        const QRgb colors[] = {
+            m_theme->textColor().rgba(), m_theme->highlightedTextColor().rgba(),
+            m_theme->backgroundColor().rgba(), m_theme->highlightColor().rgba(),
+            m_theme->positiveTextColor().rgba(), m_theme->neutralTextColor().rgba(), m_theme->negativeTextColor().rgba()
+        };
+        palette = QLatin1Char('|') + QString::number(m_theme->colorSet()) + QLatin1Char('|') + QString::number(m_theme->colorGroup())
+            + QLatin1Char('|') + QString::number(qHashBits(colors, sizeof(colors)), 16);
+    }
+
+    return source + QLatin1Char('|') + QIcon::themeName()
+        + QLatin1Char('|') + QString::number(size.width()) + QLatin1Char('x') + QString::number(size.height())
+        + QLatin1Char('@') + QString::number(devicePixelRatio)
+        + QLatin1Char('|') + QString::number(iconMode())
+        + QLatin1Char('|') + tintColor.name(QColor::HexArgb)
+        + QLatin1Char('|') + QString::number(mask) + QString::number(m_theme->supportsIconColoring())
+        + palette;
+}
+
 QImage Icon::findIcon(const QSize &size)
 {
     QImage img;
@@ -347,27 +1036,16 @@ QImage Icon::findIcon(const QSize &size)
         case QQmlImageProviderBase::ImageResponse:
         {
             if (!m_loadedImage.isNull()) {
-                setStatus(Ready);
+                setStatus(m_loadFailed ? Error : Ready);
                 return m_loadedImage.scaled(size, Qt::KeepAspectRatio, smooth() ? Qt::SmoothTransformation : Qt::FastTransformation );
             }
-            QQuickAsyncImageProvider *provider = dynamic_cast<QQuickAsyncImageProvider*>(imageProvider);
-            auto response = provider->requestImageResponse(iconId, size * multiplier);
-            connect(response, &QQuickImageResponse::finished, this, [iconId, response, this](){
-                if (response->errorString().isEmpty()) {
-                    QQuickTextureFactory *textureFactory = response->textureFactory();
-                    if (textureFactory) {
-                        m_loadedImage = textureFactory->image();
-                    }
-                    if (m_loadedImage.isNull()) {
-                        // broken image from data, inform the user of this with some useful broken-image thing...
-                        m_loadedImage = QIcon::fromTheme(m_fallback).pixmap(window(), QSize(width(), height()), iconMode(), QIcon::On).toImage();
-                        setStatus(Error);
-                    } else {
-                        setStatus(Ready);
-                    }
-                    polish();
+            if (!m_remoteLoading) {
+                m_remoteLoading = true;
+                const QString key = IconRequests::key(qmlEngine(this), iconSource, size * multiplier);
+                if (s_iconRequests->join(key, this)) {
+                    s_iconRequests->requestResponse(dynamic_cast<QQuickAsyncImageProvider*>(imageProvider), iconId, size * multiplier, key, iconSource);
                 }
-            });
+            }
             // Temporary icon while we wait for the real image to load...
             img = QIcon::fromTheme(m_placeholder).pixmap(window(), size, iconMode(), QIcon::On).toImage();
             break;
@@ -393,30 +1071,30 @@ QImage Icon::findIcon(const QSize &size)
             break;
         }
     } else if(iconSource.startsWith(QLatin1String("http://")) || iconSource.startsWith(QLatin1String("https://"))) {
-        if(!m_loadedImage.isNull()) {
-            setStatus(Ready);
-            return m_loadedImage.scaled(size, Qt::KeepAspectRatio, smooth() ? Qt::SmoothTransformation : Qt::FastTransformation );
+        // Already decoded at the right size
+        if (!m_loadedImage.isNull() && m_loadedSize == size) {
+            setStatus(m_loadFailed ? Error : Ready);
+            return m_loadedImage;
         }
-        const auto url = m_source.toUrl();
+        // Taken from the disk cache, or downloaded and decoded again at the new size
         QQmlEngine* engine = qmlEngine(this);
         QNetworkAccessManager* qnam;
-        if (engine && (qnam = engine->networkAccessManager()) && (!m_networkReply || m_networkReply->url() != url)) {
-            QNetworkRequest request(url);
-            request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
-            m_networkReply = qnam->get(request);
-            connect(m_networkReply.data(), &QNetworkReply::finished, this, [this](){
-                if (m_networkReply)
-                    handleFinished(m_networkReply);
-            });
+        if (engine && (qnam = engine->networkAccessManager()) && !m_remoteLoading) {
+            m_remoteLoading = true;
+            const QString key = IconRequests::key(engine, iconSource, size);
+            if (s_iconRequests->join(key, this)) {
+                s_iconRequests->fetch(qnam, iconSource, size, key);
+            }
+        }
+        if (!m_loadedImage.isNull()) {
+            // Shown at the previous size until the new one is ready
+            setStatus(m_loadFailed ? Error : Ready);
+            return m_loadedImage.scaled(size, Qt::KeepAspectRatio, smooth() ? Qt::SmoothTransformation : Qt::FastTransformation );
         }
         // Temporary icon while we wait for the real image to load...
         img = QIcon::fromTheme(m_placeholder).pixmap(window(), size, iconMode(), QIcon::On).toImage();
     } else {
-        if (iconSource.startsWith(QLatin1String("qrc:/"))) {
-            iconSource = iconSource.mid(3);
-        } else if (iconSource.startsWith(QLatin1String("file:/"))) {
-            iconSource = QUrl(iconSource).path();
-        }
+        iconSource = localIconSource(iconSource);
 
         QIcon icon;
         const bool isPath = iconSource.contains(QLatin1String("/"));
@@ -461,7 +1139,22 @@ QIcon::Mode Icon::iconMode() const
     return QIcon::Normal;
 }
 
-bool Icon::guessMonochrome(const QImage &img)
+bool Icon::asynchronous() const
+{
+    return m_asynchronous;
+}
+
+void Icon::setAsynchronous(bool asynchronous)
+{
+    if (asynchronous == m_asynchronous) {
+        return;
+    }
+    m_asynchronous = asynchronous;
+    polish();
+    emit asynchronousChanged();
+}
+
+bool Icon::guessMonochrome(const QImage &img, const QVariant &source, QIcon::Mode mode, bool remember)
 {
     //don't try for too big images
     if (img.width() >= 256 || m_theme->supportsIconColoring()) {
@@ -485,40 +1178,55 @@ bool Icon::guessMonochrome(const QImage &img)
         stdSize = 128;
     }
 
-    auto findIt = m_monochromeHeuristics.constFind(stdSize);
-    if (findIt != m_monochromeHeuristics.constEnd()) {
-        return findIt.value();
+    // Results are shared by all the instances showing the same icon, when it has a name to identify it
+    QString key;
+    switch (source.type()) {
+    case QVariant::Icon:
+        key = QStringLiteral("qicon:") + QString::number(source.value<QIcon>().cacheKey());
+        break;
+    case QVariant::Url:
+    case QVariant::String:
+        key = source.toString();
+        // What is shown while remote and provided images load says nothing about them
+        if (key.startsWith(QLatin1String("image://"))
+            || key.startsWith(QLatin1String("http://"))
+            || key.startsWith(QLatin1String("https://"))) {
+            key.clear();
+        }
+        break;
+    default:
+        break;
     }
 
-    QHash<int, int> dist;
-    int transparentPixels = 0;
-    int saturatedPixels = 0;
-    for(int x=0; x < img.width(); x++) {
-        for(int y=0; y < img.height(); y++) {
-            QColor color = QColor::fromRgba(qUnpremultiply(img.pixel(x, y)));
-            if (color.alpha() < 100) {
-                ++transparentPixels;
-                continue;
-            } else if (color.saturation() > 84) {
-                ++saturatedPixels;
-            }
-            dist[qGray(color.rgb())]++;
+    // The style greys out disabled icons, which then look monochrome
+    const int modeSize = stdSize * 4 + mode;
+
+    if (key.isEmpty()) {
+        if (source != m_source) {
+            return isMonochrome(img);
+        }
+        auto findIt = m_monochromeHeuristics.constFind(modeSize);
+        if (findIt != m_monochromeHeuristics.constEnd()) {
+            return findIt.value();
+        }
+        const bool monochrome = isMonochrome(img);
+        if (remember) {
+            m_monochromeHeuristics[modeSize] = monochrome;
         }
+        return monochrome;
     }
 
-    QMultiMap<int, int> reverseDist;
-    auto it = dist.constBegin();
-    qreal entropy = 0;
-    while (it != dist.constEnd()) {
-        reverseDist.insert(it.value(), it.key());
-        qreal probability = qreal(it.value()) / qreal(img.size().width() * img.size().height() - transparentPixels);
-        entropy -= probability * log(probability) / log(255);
-        ++it;
+    key += QLatin1Char('|') + QIcon::themeName() + QLatin1Char('|') + QString::number(stdSize)
+        + QLatin1Char('|') + QString::number(mode);
+    auto findIt = s_monochromeHeuristics->constFind(key);
+    if (findIt != s_monochromeHeuristics->constEnd()) {
+        return findIt.value();
     }
-
-    // Arbitrarly low values of entropy and colored pixels
-    m_monochromeHeuristics[stdSize] = saturatedPixels <= (img.size().width()*img.size().height() - transparentPixels) * 0.3 && entropy <= 0.3;
-    return m_monochromeHeuristics[stdSize];
+    const bool monochrome = isMonochrome(img);
+    if (remember) {
+        s_monochromeHeuristics->insert(key, monochrome);
+    }
+    return monochrome;
 }
 
 QString Icon::fallback() const
@@ -598,4 +1306,36 @@ void Icon::updatePaintedGeometry()
     }
 }
 
+IconTextureCache::IconTextureCache(QObject *parent)
+    : QObject(parent)
+{
+}
+
+qint64 IconTextureCache::memoryBudget() const
+{
+    return s_iconImageCache->memoryBudget();
+}
+
+void IconTextureCache::setMemoryBudget(qint64 bytes)
+{
+    if (bytes == s_iconImageCache->memoryBudget()) {
+        return;
+    }
+    s_iconImageCache->setMemoryBudget(bytes);
+    emit memoryBudgetChanged();
+}
+
+QVariantMap IconTextureCache::statistics() const
+{
+    const ImageTexturesCache::Statistics statistics = s_iconImageCache->statistics();
+    return {
+        {QStringLiteral("hits"), statistics.hits},
+        {QStringLiteral("misses"), statistics.misses},
+        {QStringLiteral("evictions"), statistics.evictions},
+        {QStringLiteral("bytes"), statistics.bytes},
+        {QStringLiteral("releasedBytes"), statistics.releasedBytes},
+        {QStringLiteral("atlasBytes"), statistics.atlasBytes},
+    };
+}
+
 #include "moc_icon.cpp"
@@ -12,8 +12,7 @@
 #include <QQuickItem>
 #include <QVariant>
 #include <QPointer>
-
-class QNetworkReply;
+#include <QSet>
 
 namespace Kirigami {
     class PlatformTheme;
@@ -25,6 +24,7 @@ namespace Kirigami {
 class Icon : public QQuickItem
 {
     Q_OBJECT
+    friend class IconRequests;
 
     /**
      * The source of this icon. An `Icon` can pull from:
@@ -145,6 +145,25 @@ class Icon : public QQuickItem
      * @since 5.15
      */
     Q_PROPERTY(qreal paintedHeight READ paintedHeight NOTIFY paintedAreaChanged)
+
+    /**
+     * Whether icons from the icon theme and from local files are decoded in a
+     * separate thread. The `placeholder` is shown and `status` stays `Loading`
+     * until the icon is ready.
+     *
+     * The file of a theme icon is looked up in the GUI thread, only decoding it
+     * happens in the other thread. Icons of platform themes which color icons
+     * themselves are still rendered in the GUI thread.
+     *
+     * Useful for Icons created in bulk, such as the ones of list delegates, where
+     * decoding many SVG files at once would otherwise delay the first frame.
+     *
+     * default: ``false``
+     *
+     * @see preload
+     * @since 2.15
+     */
+    Q_PROPERTY(bool asynchronous READ asynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
 public:
     enum Status {
         Null = 0, /// No icon has been set
@@ -185,6 +204,20 @@ public:
     qreal paintedWidth() const;
     qreal paintedHeight() const;
 
+    bool asynchronous() const;
+    void setAsynchronous(bool asynchronous);
+
+    /**
+     * Renders the given icons in a separate thread, with the size, colors and state
+     * of this Icon, so other Icons showing them later find them already rendered.
+     *
+     * Icons from the icon theme and from local files can be preloaded, with the
+     * same limits as for `asynchronous`.
+     *
+     * @since 2.15
+     */
+    Q_INVOKABLE void preload(const QStringList &sources);
+
     QSGNode* updatePaintNode(QSGNode* node, UpdatePaintNodeData* data) override;
 
 Q_SIGNALS:
@@ -198,21 +231,24 @@ Q_SIGNALS:
     void placeholderChanged(const QString &placeholder);
     void statusChanged();
     void paintedAreaChanged();
+    void asynchronousChanged();
 
 protected:
     void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
     QImage findIcon(const QSize& size);
-    void handleFinished(QNetworkReply* reply);
-    void handleRedirect(QNetworkReply* reply);
+    QString rasterCacheKey(const QVariant &iconSource, const QSize &size, const QColor &tintColor, bool mask) const;
+    bool loadAsynchronously(const QString &source, const QString &cacheKey, const QSize &size, const QColor &tintColor, bool mask);
+    static void tint(QImage &image, const QColor &tintColor);
+    void handleLoadedImage(const QString &source, const QSize &size, const QImage &image);
     QIcon::Mode iconMode() const;
-    bool guessMonochrome(const QImage &img);
+    // Only remembers the result if img is the real icon, not a placeholder or a fallback
+    bool guessMonochrome(const QImage &img, const QVariant &source, QIcon::Mode mode, bool remember);
     void setStatus(Status status);
     void updatePolish() override;
     void updatePaintedGeometry();
 
 private:
     Kirigami::PlatformTheme *m_theme = nullptr;
-    QPointer<QNetworkReply> m_networkReply;
     QHash<int, bool> m_monochromeHeuristics;
     QVariant m_source;
     Status m_status = Null;
@@ -222,12 +258,64 @@ private:
     bool m_isMask;
     bool m_isMaskHeuristic = false;
     QImage m_loadedImage;
+    // Size remote images were decoded at, and are being downloaded and decoded at
+    QSize m_loadedSize;
+    QSize m_requestedSize;
+    bool m_remoteLoading = false;
+    // m_loadedImage is the fallback shown because the remote or provided image failed to load
+    bool m_loadFailed = false;
     QColor m_color = Qt::transparent;
     QString m_fallback = QStringLiteral("unknown");
     QString m_placeholder = QStringLiteral("image-x-icon");
     qreal m_paintedWidth = 0.0;
     qreal m_paintedHeight = 0.0;
+    bool m_asynchronous = false;
+    // Raster cache keys being rendered in a thread, or which could not be
+    QSet<QString> m_pendingKeys;
+    QSet<QString> m_failedKeys;
 
     QImage m_icon;
 };
 
+/**
+ * Gives access to the textures shared by the Icons of the application.
+ *
+ * @code{.qml}
+ * Component.onCompleted: {
+ *     Kirigami.IconTextureCache.memoryBudget = 16 * 1024 * 1024
+ * }
+ * @endcode
+ *
+ * @since 2.15
+ */
+class IconTextureCache : public QObject
+{
+    Q_OBJECT
+
+    /**
+     * The memory icon textures can use, in bytes.
+     *
+     * Textures on screen are never deleted, this limits how many released
+     * textures are kept around in case an icon needs them again, for instance
+     * when a delegate scrolls back into view.
+     */
+    Q_PROPERTY(qint64 memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY memoryBudgetChanged)
+
+public:
+    explicit IconTextureCache(QObject *parent = nullptr);
+
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+    /**
+     * @returns the counters of the cache activity: "hits", "misses", "evictions",
+     * "bytes" used by the textures in use, "releasedBytes" used by the released ones
+     * and "atlasBytes" used by the atlas pages small icons are packed in, which
+     * the memory budget doesn't limit.
+     */
+    Q_INVOKABLE QVariantMap statistics() const;
+
+Q_SIGNALS:
+    void memoryBudgetChanged();
+};
+
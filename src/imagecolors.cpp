@@ -19,33 +19,395 @@
 #include "imagecolors.h"
 #include "platformtheme.h"
 
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QQmlEngine>
+#include <QQuickImageProvider>
+#include <QReadWriteLock>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 #include <QtConcurrent>
 
 #include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PALETTE_KERNEL_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PALETTE_KERNEL_NEON
+#endif
+
+// Bits kept for each channel when quantizing pixels into the palette histogram
+static const int s_histogramBits = 5;
+static const int s_histogramSize = 1 << (3 * s_histogramBits);
+
+struct HistogramBin {
+    quint64 count = 0;
+    quint64 red = 0;
+    quint64 green = 0;
+    quint64 blue = 0;
+};
+
+static inline int histogramIndex(int red, int green, int blue)
+{
+    const int shift = 8 - s_histogramBits;
+    return ((red >> shift) << (2 * s_histogramBits))
+        | ((green >> shift) << s_histogramBits)
+        | (blue >> shift);
+}
+
+// Arbitrary numbers that seem to work well
+static const float s_minimumSquareDistance = 32000;
+static const float s_minimumLabSquareDistance = 625;
+
+// Coordinates of a color in the space it's clustered in
+struct ColorCoordinates {
+    float x = 0;
+    float y = 0;
+    float z = 0;
+};
+
+/**
+ * How colors are compared while clustering them.
+ *
+ * Colors are mapped to integer coordinates and compared with a weighted square
+ * euclidean distance. All the values involved stay well below 2^24, so they are
+ * exact in single precision floats: the vectorized and the scalar kernels always
+ * agree on the result, no matter the instruction set or the compiler flags.
+ */
+struct ClusterSpace {
+    explicit ClusterSpace(ImageColors::ColorSpace colorSpace);
+
+    ColorCoordinates coordinates(QRgb rgb) const;
+    float squareDistance(const ColorCoordinates &a, const ColorCoordinates &b) const;
+    float squareDistance(QRgb a, QRgb b) const;
+
+    ImageColors::ColorSpace colorSpace;
+    // Weights of the x and z axis when the sum of the x coordinates is below 256 (low) or not (high)
+    float lowX;
+    float highX;
+    float weightY;
+    float lowZ;
+    float highZ;
+    float threshold;
+};
+
+static const float s_centroidPadding = 1.0e6f;
+
+/**
+ * Cluster centroids in structure of arrays layout, padded to whole blocks so
+ * the vectorized kernels never need a tail loop.
+ */
+class CentroidArray
+{
+public:
+    static const int s_blockSize = 4;
+
+    void clear();
+    void append(const ColorCoordinates &coordinates);
+
+    // Index of the nearest centroid closer than the threshold, -1 if there is none
+    int nearest(const ClusterSpace &space, const ColorCoordinates &coordinates) const;
+    int nearestScalar(const ClusterSpace &space, const ColorCoordinates &coordinates) const;
+
+private:
+    int m_size = 0;
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+};
+
+// Images are scaled down to this size before extracting their palette
+static const QSize s_paletteImageSize(128, 128);
+
+// Bump whenever the palette algorithm or its serialization changes, to invalidate the disk cache
+static const quint32 s_paletteCacheVersion = 2;
+
+// Limits of the disk cache, enforced once per process before the first palette is saved
+static const qint64 s_paletteDiskCacheSize = 4 * 1024 * 1024;
+static const int s_paletteDiskCacheDays = 30;
+
+/**
+ * Process-wide cache of the palettes extracted so far, shared by all the ImageColors instances.
+ *
+ * Palettes are keyed by a hash of the image contents, so identical artwork
+ * coming from different QImage instances (e.g. a grab of every delegate showing
+ * the same avatar) is computed only once; the QImage::cacheKey() of the images
+ * already seen is also remembered, so that setting again the very same image
+ * is answered without touching its pixels at all.
+ */
+class PaletteCache
+{
+public:
+    PaletteCache()
+    {
+        m_keys.setMaxCost(1024);
+        m_palettes.setMaxCost(256);
+    }
+
+    bool find(qint64 imageKey, ImageColors::ColorSpace colorSpace, ImageData *data)
+    {
+        QMutexLocker locker(&m_mutex);
+        const QByteArray *key = m_keys.object(qMakePair(imageKey, int(colorSpace)));
+        if (!key) {
+            return false;
+        }
+        const ImageData *cached = m_palettes.object(*key);
+        if (!cached) {
+            return false;
+        }
+        *data = *cached;
+        return true;
+    }
+
+    bool find(const QByteArray &key, ImageData *data)
+    {
+        QMutexLocker locker(&m_mutex);
+        const ImageData *cached = m_palettes.object(key);
+        if (!cached) {
+            return false;
+        }
+        *data = *cached;
+        return true;
+    }
+
+    void insert(qint64 imageKey, ImageColors::ColorSpace colorSpace, const QByteArray &key, const ImageData &data)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_keys.insert(qMakePair(imageKey, int(colorSpace)), new QByteArray(key));
+        m_palettes.insert(key, new ImageData(data));
+    }
+
+    static QByteArray contentKey(const QImage &image, ImageColors::ColorSpace colorSpace)
+    {
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        hash.addData(QByteArray::number(image.width()) + 'x' + QByteArray::number(image.height())
+                     + ':' + QByteArray::number(int(image.format())));
+        // Don't use bits(): the padding at the end of the scanlines is uninitialized
+        const int bytesPerLine = (image.width() * image.depth() + 7) / 8;
+        for (int y = 0; y < image.height(); ++y) {
+            hash.addData(reinterpret_cast<const char *>(image.constScanLine(y)), bytesPerLine);
+        }
+        return hash.result() + char(colorSpace);
+    }
+
+    static bool load(const QByteArray &key, ImageData *data)
+    {
+        QFile file(diskPath(key));
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_5_12);
+
+        quint32 version = 0;
+        qint32 count = 0;
+        stream >> version >> count;
+        if (version != s_paletteCacheVersion || count <= 0) {
+            return false;
+        }
+
+        ImageData result;
+        for (int i = 0; i < count; ++i) {
+            ImageData::colorStat stat;
+            stream >> stat.centroid >> stat.ratio;
+            result.m_clusters << stat;
+        }
+        stream >> result.m_palette
+               >> result.m_darkPalette
+               >> result.m_dominant
+               >> result.m_dominantContrast
+               >> result.m_average
+               >> result.m_highlight
+               >> result.m_closestToBlack
+               >> result.m_closestToWhite;
+
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+
+        // Keeps the entries still in use at the front when pruning
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+        *data = result;
+        return true;
+    }
+
+    static void save(const QByteArray &key, const ImageData &data)
+    {
+        // Nothing worth persisting for fully transparent images
+        if (data.m_clusters.isEmpty()) {
+            return;
+        }
+
+        static QBasicAtomicInt pruned = Q_BASIC_ATOMIC_INITIALIZER(0);
+        if (pruned.testAndSetRelaxed(0, 1)) {
+            prune();
+        }
+
+        const QString path = diskPath(key);
+        QDir().mkpath(QFileInfo(path).absolutePath());
+
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return;
+        }
 
-#define return_fallback(value) if (m_imageData.m_samples.size() == 0) {\
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_5_12);
+
+        stream << s_paletteCacheVersion << qint32(data.m_clusters.size());
+        for (const auto &stat : data.m_clusters) {
+            stream << stat.centroid << stat.ratio;
+        }
+        stream << data.m_palette
+               << data.m_darkPalette
+               << data.m_dominant
+               << data.m_dominantContrast
+               << data.m_average
+               << data.m_highlight
+               << data.m_closestToBlack
+               << data.m_closestToWhite;
+
+        file.commit();
+    }
+
+private:
+    static QString diskDirectory()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/kirigami/palettes");
+    }
+
+    static QString diskPath(const QByteArray &key)
+    {
+        return diskDirectory() + QLatin1Char('/') + QString::fromLatin1(key.toHex());
+    }
+
+    // Drops the entries unused for too long, then the least recently used ones over the size limit
+    static void prune()
+    {
+        const QDateTime expiry = QDateTime::currentDateTime().addDays(-s_paletteDiskCacheDays);
+        const QFileInfoList entries = QDir(diskDirectory()).entryInfoList(QDir::Files, QDir::Time);
+        qint64 size = 0;
+        for (const QFileInfo &entry : entries) {
+            if (entry.lastModified() < expiry || size + entry.size() > s_paletteDiskCacheSize) {
+                QFile::remove(entry.absoluteFilePath());
+            } else {
+                size += entry.size();
+            }
+        }
+    }
+
+    QMutex m_mutex;
+    QCache<QPair<qint64, int>, QByteArray> m_keys;
+    QCache<QByteArray, ImageData> m_palettes;
+};
+
+Q_GLOBAL_STATIC(PaletteCache, s_paletteCache)
+
+/**
+ * Palette extraction is never urgent: keep it away from the global thread pool
+ * and leave some cores free for the rest of the application.
+ */
+class PaletteThreadPool : public QThreadPool
+{
+public:
+    PaletteThreadPool()
+    {
+        setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    }
+};
+
+Q_GLOBAL_STATIC(PaletteThreadPool, s_palettePool)
+
+/**
+ * Lets palette jobs use the image providers of an engine from their thread.
+ *
+ * A child of the engine, so it is deleted when the engine is destroyed, before
+ * the providers are: it then waits for the requests in progress, and the
+ * later ones fail.
+ */
+class ImageProviderGuard : public QObject
+{
+public:
+    struct State {
+        QReadWriteLock lock;
+        bool engineAlive = true;
+    };
+
+    // Only from the thread of the engine
+    static QSharedPointer<State> state(QQmlEngine *engine)
+    {
+        auto guard = static_cast<ImageProviderGuard *>(engine->findChild<QObject *>(name(), Qt::FindDirectChildrenOnly));
+        if (!guard) {
+            guard = new ImageProviderGuard(engine);
+        }
+        return guard->m_state;
+    }
+
+    ~ImageProviderGuard() override
+    {
+        QWriteLocker locker(&m_state->lock);
+        m_state->engineAlive = false;
+    }
+
+private:
+    explicit ImageProviderGuard(QQmlEngine *engine)
+        : QObject(engine)
+        , m_state(new State)
+    {
+        setObjectName(name());
+    }
+
+    static QString name()
+    {
+        return QStringLiteral("_kirigami_imageProviderGuard");
+    }
+
+    QSharedPointer<State> m_state;
+};
+
+#define return_fallback(value) if (m_imageData.m_clusters.isEmpty()) {\
     return value;\
 }
 
-#define return_fallback_finally(value, finally) if (m_imageData.m_samples.size() == 0) {\
+#define return_fallback_finally(value, finally) if (m_imageData.m_clusters.isEmpty()) {\
     return value.isValid() ? value : static_cast<Kirigami::PlatformTheme*>(qmlAttachedPropertiesObject<Kirigami::PlatformTheme>(this, true))->finally();\
 }
 
 ImageColors::ImageColors(QObject *parent)
     : QObject(parent)
 {
+    // Compress all the update requests coming in the same event loop iteration
     m_imageSyncTimer = new QTimer(this);
     m_imageSyncTimer->setSingleShot(true);
-    m_imageSyncTimer->setInterval(100);
-   /* connect(m_imageSyncTimer, &QTimer::timeout, this, [this]() {
-       generatePalette();
-    });*/
+    m_imageSyncTimer->setInterval(0);
+    connect(m_imageSyncTimer, &QTimer::timeout, this, &ImageColors::updatePalette);
 }
 
 ImageColors::~ImageColors()
-{}
+{
+    if (m_cancelled) {
+        m_cancelled->storeRelease(1);
+    }
+}
 
 void ImageColors::setSource(const QVariant &source)
 {
@@ -54,9 +416,9 @@ void ImageColors::setSource(const QVariant &source)
     } else if (source.canConvert<QImage>()) {
         setSourceImage(source.value<QImage>());
     } else if (source.canConvert<QIcon>()) {
-        setSourceImage(source.value<QIcon>().pixmap(128, 128).toImage());
+        setSourceImage(source.value<QIcon>().pixmap(s_paletteImageSize).toImage());
     } else if (source.canConvert<QString>()) {
-        setSourceImage(QIcon::fromTheme(source.toString()).pixmap(128, 128).toImage());
+        setSourceImage(QIcon::fromTheme(source.toString()).pixmap(s_paletteImageSize).toImage());
     } else {
         return;
     }
@@ -132,29 +494,68 @@ QQuickItem *ImageColors::sourceItem() const
     return m_sourceItem;
 }
 
+void ImageColors::setColorSpace(ColorSpace colorSpace)
+{
+    if (colorSpace == m_colorSpace) {
+        return;
+    }
+
+    m_colorSpace = colorSpace;
+    update();
+    emit colorSpaceChanged();
+}
+
+ImageColors::ColorSpace ImageColors::colorSpace() const
+{
+    return m_colorSpace;
+}
+
 void ImageColors::update()
+{
+    m_imageSyncTimer->start();
+}
+
+void ImageColors::updatePalette()
 {
     if (m_futureImageData) {
+        // Jobs still queued are just dropped, the running one bails out at its next check
         m_futureImageData->cancel();
         m_futureImageData->deleteLater();
+        m_futureImageData = nullptr;
+    }
+    if (m_cancelled) {
+        m_cancelled->storeRelease(1);
+        m_cancelled.clear();
     }
+
     auto runUpdate = [this]() {
-        QFuture<ImageData> future = QtConcurrent::run([this](){return generatePalette(m_sourceImage);});
-        m_futureImageData = new QFutureWatcher<ImageData>(this);
-        connect(m_futureImageData, &QFutureWatcher<ImageData>::finished,
-                this, [this] () {
-                    if (!m_futureImageData) {
-                        return;
-                    }
-                    m_imageData = m_futureImageData->future().result();
-                    m_futureImageData->deleteLater();
-                    m_futureImageData = nullptr;
-
-                    emit paletteChanged();
-                });
-        m_futureImageData->setFuture(future);
+        ImageData cached;
+        if (s_paletteCache->find(m_sourceImage.cacheKey(), m_colorSpace, &cached)) {
+            m_imageData = cached;
+            emit paletteChanged();
+            return;
+        }
+
+        const QImage image = m_sourceImage;
+        startJob([image]() {
+            return image;
+        });
     };
 
+    if (m_sourceItem) {
+        // Decoding the image ourselves is way cheaper than a grab, which needs
+        // the item rendered offscreen and then read back from the GPU
+        const std::function<QImage()> reader = itemImageReader(m_sourceItem);
+        if (reader) {
+            if (m_grabResult) {
+                disconnect(m_grabResult.data(), nullptr, this, nullptr);
+                m_grabResult.clear();
+            }
+            startJob(reader);
+            return;
+        }
+    }
+
     if (!m_sourceItem || !m_window) {
         if (!m_sourceImage.isNull()) {
             runUpdate();
@@ -167,7 +568,7 @@ void ImageColors::update()
         m_grabResult.clear();
     }
 
-    m_grabResult = m_sourceItem->grabToImage(QSize(128, 128));
+    m_grabResult = m_sourceItem->grabToImage(s_paletteImageSize);
 
     if (m_grabResult) {
         connect(m_grabResult.data(), &QQuickItemGrabResult::ready, this, [this, runUpdate]() {
@@ -178,37 +579,329 @@ void ImageColors::update()
     }
 }
 
-inline int squareDistance(QRgb color1, QRgb color2)
+void ImageColors::startJob(const std::function<QImage()> &readImage)
+{
+    const ColorSpace colorSpace = m_colorSpace;
+    const bool persistent = m_persistentCache;
+    QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    m_cancelled = cancelled;
+    QFuture<ImageData> future = QtConcurrent::run(paletteThreadPool(), [readImage, colorSpace, persistent, cancelled]() {
+        QThread::currentThread()->setPriority(QThread::LowPriority);
+        return generateCachedPalette(readImage(), colorSpace, persistent, cancelled.data());
+    });
+    auto watcher = new QFutureWatcher<ImageData>(this);
+    m_futureImageData = watcher;
+    connect(watcher, &QFutureWatcher<ImageData>::finished,
+            this, [this, watcher] () {
+                watcher->deleteLater();
+                if (watcher != m_futureImageData) {
+                    return;
+                }
+                m_futureImageData = nullptr;
+                m_cancelled.clear();
+                m_imageData = watcher->future().result();
+
+                emit paletteChanged();
+            });
+    watcher->setFuture(future);
+}
+
+std::function<QImage()> ImageColors::itemImageReader(QQuickItem *item)
+{
+    // Only Image (and AnimatedImage) can be decoded directly, anything else must be grabbed
+    if (!item->inherits("QQuickImage")) {
+        return nullptr;
+    }
+    return imageReader(item->property("source").toUrl(), qmlEngine(item));
+}
+
+std::function<QImage()> ImageColors::imageReader(const QUrl &url, QQmlEngine *engine)
+{
+    QString path;
+    if (url.scheme() == QLatin1String("qrc")) {
+        path = QLatin1Char(':') + url.path();
+    } else if (url.isLocalFile()) {
+        path = url.toLocalFile();
+    } else if (url.scheme().isEmpty() && url.path().startsWith(QLatin1Char('/'))) {
+        path = url.path();
+    }
+
+    if (!path.isEmpty()) {
+        return [path]() {
+            QImageReader reader(path);
+            const QSize size = reader.size();
+            if (size.isValid() && (size.width() > s_paletteImageSize.width() || size.height() > s_paletteImageSize.height())) {
+                reader.setScaledSize(size.scaled(s_paletteImageSize, Qt::KeepAspectRatio));
+            }
+            return reader.read();
+        };
+    }
+
+    if (url.scheme() == QLatin1String("image") && engine) {
+        // Only providers asking for asynchronous loading promise to be thread
+        // safe; pixmap and texture providers are bound to the GUI thread, async
+        // responses would need an event loop: let all those be grabbed instead
+        QQuickImageProvider *provider = dynamic_cast<QQuickImageProvider *>(engine->imageProvider(url.host()));
+        if (provider && provider->imageType() == QQmlImageProviderBase::Image
+            && (provider->flags() & QQmlImageProviderBase::ForceAsynchronousImageLoading)) {
+            // The engine, and its providers with it, may be gone by the time the job runs
+            const QSharedPointer<ImageProviderGuard::State> guard = ImageProviderGuard::state(engine);
+            const QString id = url.toString(QUrl::RemoveScheme | QUrl::RemoveAuthority).mid(1);
+            return [guard, provider, id]() -> QImage {
+                QReadLocker locker(&guard->lock);
+                if (!guard->engineAlive) {
+                    return QImage();
+                }
+                QSize size;
+                const QImage image = provider->requestImage(id, &size, s_paletteImageSize);
+                if (image.width() > s_paletteImageSize.width() || image.height() > s_paletteImageSize.height()) {
+                    return image.scaled(s_paletteImageSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+                }
+                return image;
+            };
+        }
+    }
+
+    return nullptr;
+}
+
+ClusterSpace::ClusterSpace(ImageColors::ColorSpace colorSpace)
+    : colorSpace(colorSpace)
 {
-    // https://en.wikipedia.org/wiki/Color_difference
-    // Using RGB distance for performance, as CIEDE2000 istoo complicated
-    if (qRed(color1) - qRed(color2) < 128) {
-        return 2 * pow(qRed(color1) - qRed(color2), 2) +
-            4 * pow(qGreen(color1) - qGreen(color2), 2) +
-            3 * pow(qBlue(color1) - qBlue(color2), 2);
+    if (colorSpace == ImageColors::Lab) {
+        lowX = highX = weightY = lowZ = highZ = 1;
+        threshold = s_minimumLabSquareDistance;
     } else {
-        return 3 * pow(qRed(color1) - qRed(color2), 2) +
-            4 * pow(qGreen(color1) - qGreen(color2), 2) +
-            2 * pow(qBlue(color1) - qBlue(color2), 2);
+        // https://en.wikipedia.org/wiki/Color_difference
+        // Using RGB distance for performance, as CIEDE2000 is too complicated.
+        // Weights for red and blue depend on the mean red of the two colors
+        lowX = 2;
+        highX = 3;
+        weightY = 4;
+        lowZ = 3;
+        highZ = 2;
+        threshold = s_minimumSquareDistance;
     }
 }
 
-void ImageColors::positionColor(QRgb rgb, QList<ImageData::colorStat> &clusters)
+ColorCoordinates ClusterSpace::coordinates(QRgb rgb) const
 {
-    for (auto &stat : clusters) {
-        if (squareDistance(rgb, stat.centroid) < s_minimumSquareDistance) {
-            stat.colors.append(rgb);
-            return;
+    ColorCoordinates coordinates;
+    if (colorSpace == ImageColors::Lab) {
+        // Whole units are plenty, and keep the distances exact
+        const ColorUtils::LabColor lab = ColorUtils::colorToLab(QColor(rgb));
+        coordinates.x = qRound(lab.l);
+        coordinates.y = qRound(lab.a);
+        coordinates.z = qRound(lab.b);
+    } else {
+        coordinates.x = qRed(rgb);
+        coordinates.y = qGreen(rgb);
+        coordinates.z = qBlue(rgb);
+    }
+    return coordinates;
+}
+
+float ClusterSpace::squareDistance(const ColorCoordinates &a, const ColorCoordinates &b) const
+{
+    const float dx = a.x - b.x;
+    const float dy = a.y - b.y;
+    const float dz = a.z - b.z;
+    const bool high = a.x + b.x >= 256;
+    // Same operations in the same order as the vectorized kernels
+    return ((high ? highX : lowX) * (dx * dx) + weightY * (dy * dy)) + (high ? highZ : lowZ) * (dz * dz);
+}
+
+float ClusterSpace::squareDistance(QRgb a, QRgb b) const
+{
+    return squareDistance(coordinates(a), coordinates(b));
+}
+
+void CentroidArray::clear()
+{
+    m_size = 0;
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+}
+
+void CentroidArray::append(const ColorCoordinates &coordinates)
+{
+    if (m_size % s_blockSize == 0) {
+        // Padding lanes are so far from any color they can't ever be the nearest
+        m_x.resize(m_size + s_blockSize, s_centroidPadding);
+        m_y.resize(m_size + s_blockSize, s_centroidPadding);
+        m_z.resize(m_size + s_blockSize, s_centroidPadding);
+    }
+    m_x[m_size] = coordinates.x;
+    m_y[m_size] = coordinates.y;
+    m_z[m_size] = coordinates.z;
+    ++m_size;
+}
+
+int CentroidArray::nearestScalar(const ClusterSpace &space, const ColorCoordinates &coordinates) const
+{
+    int nearest = -1;
+    float minimum = space.threshold;
+    for (int i = 0; i < m_size; ++i) {
+        ColorCoordinates centroid;
+        centroid.x = m_x[i];
+        centroid.y = m_y[i];
+        centroid.z = m_z[i];
+        const float distance = space.squareDistance(coordinates, centroid);
+        if (distance < minimum) {
+            minimum = distance;
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+
+#if defined(PALETTE_KERNEL_SSE2) || defined(PALETTE_KERNEL_NEON)
+// Every lane tracked the first of its nearest centroids: pick the nearest
+// among them, the lowest index on ties, exactly like the scalar loop does
+static int reduceLanes(const float *minimums, const qint32 *indexes)
+{
+    int nearest = -1;
+    float minimum = 0;
+    for (int lane = 0; lane < CentroidArray::s_blockSize; ++lane) {
+        if (indexes[lane] < 0) {
+            continue;
+        }
+        if (nearest < 0 || minimums[lane] < minimum
+            || (minimums[lane] == minimum && indexes[lane] < nearest)) {
+            minimum = minimums[lane];
+            nearest = indexes[lane];
         }
     }
+    return nearest;
+}
+#endif
+
+#if defined(PALETTE_KERNEL_SSE2)
+int CentroidArray::nearest(const ClusterSpace &space, const ColorCoordinates &coordinates) const
+{
+    const __m128 x = _mm_set1_ps(coordinates.x);
+    const __m128 y = _mm_set1_ps(coordinates.y);
+    const __m128 z = _mm_set1_ps(coordinates.z);
+    const __m128 lowX = _mm_set1_ps(space.lowX);
+    const __m128 highX = _mm_set1_ps(space.highX);
+    const __m128 weightY = _mm_set1_ps(space.weightY);
+    const __m128 lowZ = _mm_set1_ps(space.lowZ);
+    const __m128 highZ = _mm_set1_ps(space.highZ);
+    const __m128 highSum = _mm_set1_ps(256);
+    const __m128i step = _mm_set1_epi32(s_blockSize);
+
+    __m128 minimum = _mm_set1_ps(space.threshold);
+    __m128i nearest = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+
+    for (int i = 0; i < m_size; i += s_blockSize) {
+        const __m128 cx = _mm_loadu_ps(m_x.data() + i);
+        const __m128 cy = _mm_loadu_ps(m_y.data() + i);
+        const __m128 cz = _mm_loadu_ps(m_z.data() + i);
+        const __m128 dx = _mm_sub_ps(x, cx);
+        const __m128 dy = _mm_sub_ps(y, cy);
+        const __m128 dz = _mm_sub_ps(z, cz);
+
+        const __m128 high = _mm_cmpge_ps(_mm_add_ps(x, cx), highSum);
+        const __m128 weightX = _mm_or_ps(_mm_and_ps(high, highX), _mm_andnot_ps(high, lowX));
+        const __m128 weightZ = _mm_or_ps(_mm_and_ps(high, highZ), _mm_andnot_ps(high, lowZ));
+
+        const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(weightX, _mm_mul_ps(dx, dx)),
+                                                      _mm_mul_ps(weightY, _mm_mul_ps(dy, dy))),
+                                           _mm_mul_ps(weightZ, _mm_mul_ps(dz, dz)));
+
+        const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, minimum));
+        minimum = _mm_min_ps(distance, minimum);
+        nearest = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, nearest));
+        index = _mm_add_epi32(index, step);
+    }
+
+    float minimums[s_blockSize];
+    qint32 indexes[s_blockSize];
+    _mm_storeu_ps(minimums, minimum);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(indexes), nearest);
+    return reduceLanes(minimums, indexes);
+}
+#elif defined(PALETTE_KERNEL_NEON)
+int CentroidArray::nearest(const ClusterSpace &space, const ColorCoordinates &coordinates) const
+{
+    const float32x4_t x = vdupq_n_f32(coordinates.x);
+    const float32x4_t y = vdupq_n_f32(coordinates.y);
+    const float32x4_t z = vdupq_n_f32(coordinates.z);
+    const float32x4_t lowX = vdupq_n_f32(space.lowX);
+    const float32x4_t highX = vdupq_n_f32(space.highX);
+    const float32x4_t weightY = vdupq_n_f32(space.weightY);
+    const float32x4_t lowZ = vdupq_n_f32(space.lowZ);
+    const float32x4_t highZ = vdupq_n_f32(space.highZ);
+    const float32x4_t highSum = vdupq_n_f32(256);
+    const int32x4_t step = vdupq_n_s32(s_blockSize);
+
+    const qint32 firstIndexes[s_blockSize] = {0, 1, 2, 3};
+    float32x4_t minimum = vdupq_n_f32(space.threshold);
+    int32x4_t nearest = vdupq_n_s32(-1);
+    int32x4_t index = vld1q_s32(firstIndexes);
+
+    for (int i = 0; i < m_size; i += s_blockSize) {
+        const float32x4_t cx = vld1q_f32(m_x.data() + i);
+        const float32x4_t cy = vld1q_f32(m_y.data() + i);
+        const float32x4_t cz = vld1q_f32(m_z.data() + i);
+        const float32x4_t dx = vsubq_f32(x, cx);
+        const float32x4_t dy = vsubq_f32(y, cy);
+        const float32x4_t dz = vsubq_f32(z, cz);
+
+        const uint32x4_t high = vcgeq_f32(vaddq_f32(x, cx), highSum);
+        const float32x4_t weightX = vbslq_f32(high, highX, lowX);
+        const float32x4_t weightZ = vbslq_f32(high, highZ, lowZ);
+
+        const float32x4_t distance = vaddq_f32(vaddq_f32(vmulq_f32(weightX, vmulq_f32(dx, dx)),
+                                                         vmulq_f32(weightY, vmulq_f32(dy, dy))),
+                                               vmulq_f32(weightZ, vmulq_f32(dz, dz)));
+
+        const uint32x4_t closer = vcltq_f32(distance, minimum);
+        minimum = vminq_f32(distance, minimum);
+        nearest = vbslq_s32(closer, index, nearest);
+        index = vaddq_s32(index, step);
+    }
+
+    float minimums[s_blockSize];
+    qint32 indexes[s_blockSize];
+    vst1q_f32(minimums, minimum);
+    vst1q_s32(indexes, nearest);
+    return reduceLanes(minimums, indexes);
+}
+#else
+int CentroidArray::nearest(const ClusterSpace &space, const ColorCoordinates &coordinates) const
+{
+    return nearestScalar(space, coordinates);
+}
+#endif
+
+// Adds the sample to the nearest cluster close enough, or makes it the seed of a new one
+static void positionColor(const ImageData::colorSample &sample, const ColorCoordinates &coordinates,
+                          const ClusterSpace &space, QList<ImageData::colorStat> &clusters, CentroidArray &centroids)
+{
+    const int nearest = centroids.nearest(space, coordinates);
+    if (nearest >= 0) {
+        ImageData::colorStat &stat = clusters[nearest];
+        stat.count += sample.count;
+        stat.red += qRed(sample.rgb) * sample.count;
+        stat.green += qGreen(sample.rgb) * sample.count;
+        stat.blue += qBlue(sample.rgb) * sample.count;
+        return;
+    }
 
     ImageData::colorStat stat;
-    stat.colors.append(rgb);
-    stat.centroid = rgb;
+    stat.centroid = sample.rgb;
+    stat.count = sample.count;
+    stat.red = qRed(sample.rgb) * sample.count;
+    stat.green = qGreen(sample.rgb) * sample.count;
+    stat.blue = qBlue(sample.rgb) * sample.count;
     clusters << stat;
+    centroids.append(coordinates);
 }
 
-ImageData ImageColors::generatePalette(const QImage &sourceImage)
+ImageData ImageColors::generatePalette(const QImage &sourceImage, ColorSpace colorSpace, const QAtomicInt *cancelled)
 {
     ImageData imageData;
 
@@ -216,64 +909,110 @@ ImageData ImageColors::generatePalette(const QImage &sourceImage)
         return imageData;
     }
 
-    imageData.m_clusters.clear();
-    imageData.m_samples.clear();
-
-    QColor sampleColor;
-    int r = 0;
-    int g = 0;
-    int b = 0;
-    int c = 0;
-    for (int x = 0; x < sourceImage.width(); ++x) {
-        for (int y = 0; y < sourceImage.height(); ++y) {
-            sampleColor = sourceImage.pixelColor(x, y);
-            if (sampleColor.alpha() == 0) {
+    // No copy is done if the image already is in the right format
+    const QImage image = sourceImage.convertToFormat(QImage::Format_ARGB32);
+
+    // Walk the pixels once in scanline order, accumulating them in a quantized
+    // histogram: the clustering then works on the non empty bins, weighted by
+    // their pixel count, rather than on every single pixel
+    std::vector<HistogramBin> histogram(s_histogramSize);
+    quint64 r = 0;
+    quint64 g = 0;
+    quint64 b = 0;
+    quint64 c = 0;
+    for (int y = 0; y < image.height(); ++y) {
+        if (cancelled && cancelled->loadAcquire()) {
+            return imageData;
+        }
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            const QRgb rgb = line[x];
+            if (qAlpha(rgb) == 0) {
                 continue;
             }
-            QRgb rgb = sampleColor.rgb();
+            const int red = qRed(rgb);
+            const int green = qGreen(rgb);
+            const int blue = qBlue(rgb);
+            HistogramBin &bin = histogram[histogramIndex(red, green, blue)];
+            bin.count++;
+            bin.red += red;
+            bin.green += green;
+            bin.blue += blue;
             c++;
-            r += qRed(rgb);
-            g += qGreen(rgb);
-            b += qBlue(rgb);
-            imageData.m_samples << rgb;
-            positionColor(rgb, imageData.m_clusters);
+            r += red;
+            g += green;
+            b += blue;
         }
     }
 
-    if (imageData.m_samples.isEmpty()) {
+    if (c == 0) {
         return imageData;
     }
 
-    imageData.m_average = QColor(r/c, g/c, b/c, 255);
+    imageData.m_average = QColor(int(r / c), int(g / c), int(b / c), 255);
 
-    for (int iteration = 0; iteration < 5; ++iteration) {
-        for (auto &stat : imageData.m_clusters) {
-            r = 0;
-            g = 0;
-            b = 0;
-            c = 0;
-
-            for (auto color : qAsConst(stat.colors)) {
-                c++;
-                r += qRed(color);
-                g += qGreen(color);
-                b += qBlue(color);
+    QVector<ImageData::colorSample> samples;
+    for (const auto &bin : histogram) {
+        if (bin.count == 0) {
+            continue;
+        }
+        ImageData::colorSample sample;
+        sample.rgb = qRgb(bin.red / bin.count, bin.green / bin.count, bin.blue / bin.count);
+        sample.count = bin.count;
+        samples << sample;
+    }
+
+    // Most populated bins go first, so they are the ones seeding the clusters
+    std::sort(samples.begin(), samples.end(), [](const ImageData::colorSample &a, const ImageData::colorSample &b) {
+        return a.count > b.count;
+    });
+
+    const ClusterSpace space(colorSpace);
+    QVector<ColorCoordinates> sampleCoordinates;
+    sampleCoordinates.reserve(samples.size());
+    for (const auto &sample : qAsConst(samples)) {
+        sampleCoordinates << space.coordinates(sample.rgb);
+    }
+
+    CentroidArray centroids;
+
+    // Moves every cluster to the weighted average of its bins, dropping the ones left empty
+    auto updateCentroids = [&imageData, &centroids, &space, c]() {
+        centroids.clear();
+        auto it = imageData.m_clusters.begin();
+        while (it != imageData.m_clusters.end()) {
+            if (it->count == 0) {
+                it = imageData.m_clusters.erase(it);
+                continue;
             }
-            r = r / c;
-            g = g / c;
-            b = b / c;
-            stat.centroid = qRgb(r, g, b);
-            stat.ratio = qreal(stat.colors.count()) / qreal(imageData.m_samples.count());
-            stat.colors = QList<QRgb>({stat.centroid});
+            it->centroid = qRgb(it->red / it->count, it->green / it->count, it->blue / it->count);
+            it->ratio = qreal(it->count) / qreal(c);
+            it->count = 0;
+            it->red = 0;
+            it->green = 0;
+            it->blue = 0;
+            centroids.append(space.coordinates(it->centroid));
+            ++it;
         }
+    };
 
-        for (auto color : qAsConst(imageData.m_samples)) {
-            positionColor(color, imageData.m_clusters);
+    for (int i = 0; i < samples.size(); ++i) {
+        positionColor(samples[i], sampleCoordinates[i], space, imageData.m_clusters, centroids);
+    }
+
+    for (int iteration = 0; iteration < 5; ++iteration) {
+        if (cancelled && cancelled->loadAcquire()) {
+            return imageData;
+        }
+        updateCentroids();
+        for (int i = 0; i < samples.size(); ++i) {
+            positionColor(samples[i], sampleCoordinates[i], space, imageData.m_clusters, centroids);
         }
     }
+    updateCentroids();
 
     std::sort(imageData.m_clusters.begin(), imageData.m_clusters.end(), [](const ImageData::colorStat &a, const ImageData::colorStat &b) {
-        return a.colors.size() > b.colors.size();   
+        return a.ratio > b.ratio;
     });
 
     // compress blocks that became too similar
@@ -282,7 +1021,7 @@ ImageData ImageColors::generatePalette(const QImage &sourceImage)
     while (sourceIt != imageData.m_clusters.begin()) {
         sourceIt--;
         for (auto destIt = imageData.m_clusters.begin(); destIt != imageData.m_clusters.end() && destIt != sourceIt; destIt++) {
-            if (squareDistance((*sourceIt).centroid, (*destIt).centroid) < s_minimumSquareDistance) {
+            if (space.squareDistance((*sourceIt).centroid, (*destIt).centroid) < space.threshold) {
                 const qreal ratio = (*sourceIt).ratio / (*destIt).ratio;
                 const int r = ratio * qreal(qRed((*sourceIt).centroid)) +
                     (1 - ratio) * qreal(qRed((*destIt).centroid));
@@ -321,9 +1060,10 @@ ImageData ImageColors::generatePalette(const QImage &sourceImage)
                         contrast.hslSaturation(),
                         128 + (128 - contrast.lightness()));
         QColor tempContrast;
-        int minimumDistance = 4681800; //max distance: 4*3*2*3*255*255
+        const ColorCoordinates contrastCoordinates = space.coordinates(contrast.rgb());
+        float minimumDistance = std::numeric_limits<float>::max();
         for (const auto &stat : qAsConst(imageData.m_clusters)) {
-            const int distance = squareDistance(contrast.rgb(), stat.centroid);
+            const float distance = space.squareDistance(contrastCoordinates, space.coordinates(stat.centroid));
 
             if (distance < minimumDistance) {
                 tempContrast = QColor(stat.centroid);
@@ -339,7 +1079,7 @@ ImageData ImageColors::generatePalette(const QImage &sourceImage)
                 contrast = QColor(20, 20, 20);
             }
         // TODO: replace m_clusters.size() > 3 with entropy calculation
-        } else if (squareDistance(contrast.rgb(), tempContrast.rgb()) < s_minimumSquareDistance * 1.5) {
+        } else if (space.squareDistance(contrast.rgb(), tempContrast.rgb()) < space.threshold * 1.5) {
             contrast = tempContrast;
         } else {
             contrast = tempContrast;
@@ -375,9 +1115,38 @@ ImageData ImageColors::generatePalette(const QImage &sourceImage)
     return imageData;
 }
 
+QThreadPool *ImageColors::paletteThreadPool()
+{
+    return s_palettePool();
+}
+
+ImageData ImageColors::generateCachedPalette(const QImage &sourceImage, ColorSpace colorSpace, bool persistent, const QAtomicInt *cancelled)
+{
+    if (sourceImage.isNull()) {
+        return ImageData();
+    }
+
+    const QByteArray key = PaletteCache::contentKey(sourceImage, colorSpace);
+
+    ImageData imageData;
+    if (!s_paletteCache->find(key, &imageData)
+        && (!persistent || !PaletteCache::load(key, &imageData))) {
+        imageData = generatePalette(sourceImage, colorSpace, cancelled);
+        if (cancelled && cancelled->loadAcquire()) {
+            // Partial result, nobody is waiting for it anyways
+            return imageData;
+        }
+        if (persistent) {
+            PaletteCache::save(key, imageData);
+        }
+    }
+
+    s_paletteCache->insert(sourceImage.cacheKey(), colorSpace, key, imageData);
+    return imageData;
+}
+
 QVariantList ImageColors::palette() const
 {
-    if (m_futureImageData) qWarning()<< m_futureImageData->future().isFinished();
     return_fallback(m_fallbackPalette)
     return m_imageData.m_palette;
 }
@@ -28,14 +28,31 @@
 #include <QPointer>
 #include <QQuickWindow>
 #include <QFuture>
+#include <QUrl>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+#include <functional>
 
 class QTimer;
+class QThreadPool;
+class QQmlEngine;
 
 struct ImageData {
     struct colorStat {
-        QList<QRgb> colors;
         QRgb centroid = 0;
         qreal ratio = 0;
+        // Accumulators of the histogram bins currently assigned to the cluster
+        quint64 count = 0;
+        quint64 red = 0;
+        quint64 green = 0;
+        quint64 blue = 0;
+    };
+
+    // A quantized histogram bin: its mean color and how many pixels fell in it
+    struct colorSample {
+        QRgb rgb = 0;
+        quint64 count = 0;
     };
 
     struct colorSet {
@@ -45,7 +62,6 @@ struct ImageData {
         QColor highlight;
     };
 
-    QList<QRgb> m_samples;
     QList<colorStat> m_clusters;
     QVariantList m_palette;
 
@@ -72,6 +88,10 @@ class ImageColors : public QObject
      * * Icon name
      *
      * Note that an Item's color palette will only be extracted once unless you * call `update()`, regardless of how the item hanges.
+     *
+     * When the Item is an Image loading a local file, a resource or the url of
+     * an image provider which forces asynchronous loading, the image is decoded
+     * directly in a thread; any other Item gets rendered offscreen with grabToImage.
      */
     Q_PROPERTY(QVariant source READ source WRITE setSource NOTIFY sourceChanged)
 
@@ -209,7 +229,42 @@ class ImageColors : public QObject
      */
     Q_PROPERTY(QColor fallbackBackground MEMBER m_fallbackBackground NOTIFY fallbackBackgroundChanged)
 
+    /**
+     * Whether the extracted palette should also be stored on disk, so that it
+     * survives application restarts.
+     *
+     * Palettes are always shared process-wide between ImageColors instances
+     * with the same source image; this enables a persistent tier, in the
+     * application cache directory, on top of that. Palettes not used for a
+     * month, and the least recently used ones past a few megabytes, are
+     * removed from it.
+     *
+     * default: ``false``
+     */
+    Q_PROPERTY(bool persistentCache MEMBER m_persistentCache NOTIFY persistentCacheChanged)
+
+    /**
+     * The color space in which colors are compared while clustering them.
+     *
+     * * ImageColors.WeightedRGB: a weighted euclidean distance of the RGB
+     *   components, cheap and usually good enough.
+     * * ImageColors.Lab: the euclidean distance in the perceptually uniform
+     *   CIELAB color space; tells apart better the subtle shades of images
+     *   which are mostly gradients.
+     *
+     * default: ``ImageColors.WeightedRGB``
+     *
+     * \sa https://en.wikipedia.org/wiki/Color_difference
+     */
+    Q_PROPERTY(ColorSpace colorSpace READ colorSpace WRITE setColorSpace NOTIFY colorSpaceChanged)
+
 public:
+    enum ColorSpace {
+        WeightedRGB,
+        Lab,
+    };
+    Q_ENUM(ColorSpace)
+
     explicit ImageColors(QObject* parent = nullptr);
     ~ImageColors();
 
@@ -222,6 +277,9 @@ public:
     void setSourceItem(QQuickItem *source);
     QQuickItem *sourceItem() const;
 
+    void setColorSpace(ColorSpace colorSpace);
+    ColorSpace colorSpace() const;
+
     Q_INVOKABLE void update();
 
     QVariantList palette() const;
@@ -246,13 +304,20 @@ Q_SIGNALS:
     void fallbackHighlightChanged();
     void fallbackForegroundChanged();
     void fallbackBackgroundChanged();
+    void persistentCacheChanged();
+    void colorSpaceChanged();
 
 private:
-    static inline void positionColor(QRgb rgb, QList<ImageData::colorStat> &clusters);
-    static ImageData generatePalette(const QImage &sourceImage);
+    friend class ImageColorsModel;
+
+    static QThreadPool *paletteThreadPool();
+    static ImageData generatePalette(const QImage &sourceImage, ColorSpace colorSpace = WeightedRGB, const QAtomicInt *cancelled = nullptr);
+    static ImageData generateCachedPalette(const QImage &sourceImage, ColorSpace colorSpace, bool persistent, const QAtomicInt *cancelled);
+    void updatePalette();
+    void startJob(const std::function<QImage()> &readImage);
+    static std::function<QImage()> itemImageReader(QQuickItem *item);
+    static std::function<QImage()> imageReader(const QUrl &url, QQmlEngine *engine);
 
-    // Arbitrary number that seems to work well
-    static const int s_minimumSquareDistance = 32000;
     QPointer<QQuickWindow> m_window;
     QVariant m_source;
     QPointer<QQuickItem> m_sourceItem;
@@ -263,6 +328,8 @@ private:
     QTimer *m_imageSyncTimer;
 
     QFutureWatcher<ImageData> *m_futureImageData = nullptr;
+    // Raised when the running palette job got superseded, polled by the job itself
+    QSharedPointer<QAtomicInt> m_cancelled;
     ImageData m_imageData;
 
     QVariantList m_fallbackPalette;
@@ -273,5 +340,8 @@ private:
     QColor m_fallbackHighlight;
     QColor m_fallbackForeground;
     QColor m_fallbackBackground;
+
+    bool m_persistentCache = false;
+    ColorSpace m_colorSpace = WeightedRGB;
 };
 
@@ -0,0 +1,347 @@
+/*
+ *  SPDX-FileCopyrightText: 2020 The KDE Community
+ *
+ *  SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include "imagecolorsmodel.h"
+
+#include <QIcon>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQmlEngine>
+#include <QRunnable>
+#include <QStringListModel>
+#include <QThread>
+#include <QThreadPool>
+#include <QUrl>
+
+#include <functional>
+
+// Size icons are rendered at, same as ImageColors
+static const QSize s_iconSize(128, 128);
+
+// Palettes kept by each model
+static const int s_maximumPalettes = 512;
+
+/**
+ * Shared between the model and its running jobs: once the model is gone,
+ * jobs stop as soon as they can and don't try to deliver their result.
+ */
+struct ImageColorsModelRelay {
+    QMutex mutex;
+    ImageColorsModel *model = nullptr;
+    QAtomicInt cancelled;
+};
+
+class PaletteJob : public QRunnable
+{
+public:
+    explicit PaletteJob(const std::function<void()> &function)
+        : m_function(function)
+    {
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+
+ImageColorsModel::ImageColorsModel(QObject *parent)
+    : QIdentityProxyModel(parent)
+    , m_relay(new ImageColorsModelRelay)
+{
+    m_relay->model = this;
+    m_palettes.setMaxCost(s_maximumPalettes);
+
+    connect(this, &QAbstractItemModel::modelReset, this, [this]() {
+        // Jobs already running still deliver their palette, but nobody waits for the queued ones
+        m_palettes.clear();
+        m_waitingIndexes.clear();
+        m_queue.clear();
+        updateSourceRole();
+        if (m_prefetch) {
+            prefetchRows(0, rowCount() - 1);
+        }
+    });
+    connect(this, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &parent, int first, int last) {
+        if (m_prefetch && !parent.isValid()) {
+            prefetchRows(first, last);
+        }
+    });
+}
+
+ImageColorsModel::~ImageColorsModel()
+{
+    QMutexLocker locker(&m_relay->mutex);
+    m_relay->model = nullptr;
+    m_relay->cancelled.storeRelease(1);
+}
+
+void ImageColorsModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (sourceModel == this->sourceModel()) {
+        return;
+    }
+
+    const bool hadSources = m_sourcesModel && this->sourceModel() == m_sourcesModel;
+
+    // Resets the model, which takes care of the source role and of prefetching
+    QIdentityProxyModel::setSourceModel(sourceModel);
+
+    if (hadSources || (m_sourcesModel && sourceModel == m_sourcesModel)) {
+        emit sourcesChanged();
+    }
+}
+
+QStringList ImageColorsModel::sources() const
+{
+    if (!m_sourcesModel || sourceModel() != m_sourcesModel) {
+        return QStringList();
+    }
+    return m_sourcesModel->stringList();
+}
+
+void ImageColorsModel::setSources(const QStringList &sources)
+{
+    if (!m_sourcesModel) {
+        m_sourcesModel = new QStringListModel(this);
+    }
+
+    if (sourceModel() == m_sourcesModel) {
+        if (m_sourcesModel->stringList() == sources) {
+            return;
+        }
+        m_sourcesModel->setStringList(sources);
+        emit sourcesChanged();
+    } else {
+        m_sourcesModel->setStringList(sources);
+        setSourceModel(m_sourcesModel);
+    }
+}
+
+QString ImageColorsModel::sourceRole() const
+{
+    return m_sourceRole;
+}
+
+void ImageColorsModel::setSourceRole(const QString &role)
+{
+    if (role == m_sourceRole) {
+        return;
+    }
+
+    m_sourceRole = role;
+    updateSourceRole();
+    emit sourceRoleChanged();
+
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 0), index(rowCount() - 1, 0));
+    }
+}
+
+bool ImageColorsModel::prefetch() const
+{
+    return m_prefetch;
+}
+
+void ImageColorsModel::setPrefetch(bool prefetch)
+{
+    if (prefetch == m_prefetch) {
+        return;
+    }
+
+    m_prefetch = prefetch;
+    if (m_prefetch) {
+        prefetchRows(0, rowCount() - 1);
+    }
+    emit prefetchChanged();
+}
+
+QVariant ImageColorsModel::data(const QModelIndex &index, int role) const
+{
+    if (role < PaletteRole || role > ClosestToBlackRole) {
+        return QIdentityProxyModel::data(index, role);
+    }
+
+    const QString source = imageSource(index);
+    if (source.isEmpty()) {
+        return QVariant();
+    }
+
+    const ImageData *cached = m_palettes.object(source);
+    if (!cached) {
+        requestPalette(source, index);
+        return QVariant();
+    }
+
+    const ImageData &imageData = *cached;
+    if (imageData.m_clusters.isEmpty()) {
+        return QVariant();
+    }
+
+    switch (role) {
+    case PaletteRole:
+        return imageData.m_palette;
+    case PaletteBrightnessRole:
+        return qGray(imageData.m_dominant.rgb()) < 128 ? ColorUtils::Dark : ColorUtils::Light;
+    case AverageRole:
+        return imageData.m_average;
+    case DominantRole:
+        return imageData.m_dominant;
+    case DominantContrastRole:
+        return imageData.m_dominantContrast;
+    case HighlightRole:
+        return imageData.m_highlight;
+    case ClosestToWhiteRole:
+        return imageData.m_closestToWhite;
+    case ClosestToBlackRole:
+        return imageData.m_closestToBlack;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> ImageColorsModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QIdentityProxyModel::roleNames();
+    roles[PaletteRole] = QByteArrayLiteral("palette");
+    roles[PaletteBrightnessRole] = QByteArrayLiteral("paletteBrightness");
+    roles[AverageRole] = QByteArrayLiteral("average");
+    roles[DominantRole] = QByteArrayLiteral("dominant");
+    roles[DominantContrastRole] = QByteArrayLiteral("dominantContrast");
+    roles[HighlightRole] = QByteArrayLiteral("highlight");
+    roles[ClosestToWhiteRole] = QByteArrayLiteral("closestToWhite");
+    roles[ClosestToBlackRole] = QByteArrayLiteral("closestToBlack");
+    return roles;
+}
+
+QString ImageColorsModel::imageSource(const QModelIndex &index) const
+{
+    const QVariant value = QIdentityProxyModel::data(index, m_sourceRoleId);
+    if (value.type() == QVariant::Url) {
+        return value.toUrl().toString();
+    }
+    return value.toString();
+}
+
+void ImageColorsModel::updateSourceRole()
+{
+    m_sourceRoleId = Qt::DisplayRole;
+    if (m_sourceRole.isEmpty() || !sourceModel()) {
+        return;
+    }
+
+    const QHash<int, QByteArray> roles = sourceModel()->roleNames();
+    const int role = roles.key(m_sourceRole.toUtf8(), -1);
+    if (role != -1) {
+        m_sourceRoleId = role;
+    }
+}
+
+void ImageColorsModel::requestPalette(const QString &source, const QModelIndex &index) const
+{
+    // Sources are in m_waitingIndexes from when they get queued until their palette is ready
+    const bool scheduled = m_waitingIndexes.contains(source);
+
+    QList<QPersistentModelIndex> &waiting = m_waitingIndexes[source];
+    const QPersistentModelIndex persistentIndex(index);
+    if (!waiting.contains(persistentIndex)) {
+        waiting << persistentIndex;
+    }
+
+    // Either new or still queued: in both cases it's now the most urgent one
+    if (!scheduled) {
+        m_queue.prepend(source);
+    } else {
+        const int queued = m_queue.indexOf(source);
+        if (queued > 0) {
+            m_queue.move(queued, 0);
+        }
+    }
+
+    schedule();
+}
+
+void ImageColorsModel::prefetchRows(int first, int last)
+{
+    for (int row = first; row <= last; ++row) {
+        const QString source = imageSource(index(row, 0));
+        if (source.isEmpty() || m_palettes.contains(source) || m_waitingIndexes.contains(source)) {
+            continue;
+        }
+        // Nobody is waiting for it yet, but this marks it as scheduled
+        m_waitingIndexes[source];
+        m_queue.append(source);
+    }
+
+    schedule();
+}
+
+void ImageColorsModel::schedule() const
+{
+    // Keep the queue on our side rather than in the thread pool, so the most
+    // recently requested sources can always jump ahead of the older ones
+    const int maxJobs = ImageColors::paletteThreadPool()->maxThreadCount();
+    while (m_runningJobs < maxJobs && !m_queue.isEmpty()) {
+        startJob(m_queue.takeFirst());
+    }
+}
+
+void ImageColorsModel::startJob(const QString &source) const
+{
+    const QUrl url = source.startsWith(QLatin1Char('/')) || source.startsWith(QLatin1Char(':'))
+        ? QUrl::fromLocalFile(source)
+        : QUrl(source);
+    const std::function<QImage()> reader = ImageColors::imageReader(url, qmlEngine(this));
+    QImage image;
+    if (!reader) {
+        // Icons can only be rendered in the GUI thread
+        const QIcon icon = QIcon::fromTheme(source);
+        if (!icon.isNull()) {
+            image = icon.pixmap(s_iconSize).toImage();
+        }
+    }
+
+    const QSharedPointer<ImageColorsModelRelay> relay = m_relay;
+    const bool persistent = m_persistentCache;
+    ++m_runningJobs;
+
+    ImageColors::paletteThreadPool()->start(new PaletteJob([relay, source, reader, image, persistent]() {
+        QThread::currentThread()->setPriority(QThread::LowPriority);
+
+        const QImage sourceImage = reader ? reader() : image;
+        const ImageData imageData = ImageColors::generateCachedPalette(sourceImage, ImageColors::WeightedRGB, persistent, &relay->cancelled);
+
+        QMutexLocker locker(&relay->mutex);
+        ImageColorsModel *model = relay->model;
+        if (model) {
+            QMetaObject::invokeMethod(model, [model, source, imageData]() {
+                model->paletteReady(source, imageData);
+            }, Qt::QueuedConnection);
+        }
+    }));
+}
+
+void ImageColorsModel::paletteReady(const QString &source, const ImageData &data)
+{
+    --m_runningJobs;
+    m_palettes.insert(source, new ImageData(data));
+
+    const QVector<int> roles = {PaletteRole, PaletteBrightnessRole, AverageRole, DominantRole,
+        DominantContrastRole, HighlightRole, ClosestToWhiteRole, ClosestToBlackRole};
+    const QList<QPersistentModelIndex> waiting = m_waitingIndexes.take(source);
+    for (const QPersistentModelIndex &index : waiting) {
+        if (index.isValid()) {
+            emit dataChanged(index, index, roles);
+        }
+    }
+
+    schedule();
+}
+
+#include "moc_imagecolorsmodel.cpp"
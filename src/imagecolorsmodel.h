@@ -0,0 +1,151 @@
+/*
+ *  SPDX-FileCopyrightText: 2020 The KDE Community
+ *
+ *  SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QCache>
+#include <QHash>
+#include <QIdentityProxyModel>
+#include <QPersistentModelIndex>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include "imagecolors.h"
+
+class QStringListModel;
+struct ImageColorsModelRelay;
+
+/**
+ * A proxy model adding the palette of an image to every row of its source model.
+ *
+ * This is the batch counterpart of ImageColors: rather than one ImageColors
+ * object per delegate, a single model schedules the palette extraction of all
+ * its rows on a shared pool of threads, using the same clustering code.
+ *
+ * Rows are processed on demand: the palette of a row is computed when a view
+ * asks for one of the palette roles, the most recently requested rows going
+ * first, so the rows currently visible get their palette before the ones
+ * which already scrolled away.
+ *
+ * Images can be local files, qrc resources, image provider urls or icon names.
+ *
+ * @code{.qml}
+ * ListView {
+ *     model: Kirigami.ImageColorsModel {
+ *         sourceModel: albumsModel
+ *         sourceRole: "cover"
+ *     }
+ *     delegate: Rectangle {
+ *         color: model.dominant || "transparent"
+ *         ...
+ *     }
+ * }
+ * @endcode
+ *
+ * @since 2.15
+ */
+class ImageColorsModel : public QIdentityProxyModel
+{
+    Q_OBJECT
+
+    /**
+     * The model whose rows contain the images to extract palettes from.
+     */
+    Q_PROPERTY(QAbstractItemModel *sourceModel READ sourceModel WRITE setSourceModel NOTIFY sourceModelChanged)
+
+    /**
+     * A plain list of images, used instead of sourceModel.
+     *
+     * Setting it replaces sourceModel with an internal model whose rows are the
+     * entries of the list.
+     */
+    Q_PROPERTY(QStringList sources READ sources WRITE setSources NOTIFY sourcesChanged)
+
+    /**
+     * The name of the source model role containing the image of every row.
+     *
+     * default: the display role
+     */
+    Q_PROPERTY(QString sourceRole READ sourceRole WRITE setSourceRole NOTIFY sourceRoleChanged)
+
+    /**
+     * When true, the palettes of all the rows are computed in background, after
+     * the ones explicitly requested by a view.
+     *
+     * default: ``false``
+     */
+    Q_PROPERTY(bool prefetch READ prefetch WRITE setPrefetch NOTIFY prefetchChanged)
+
+    /**
+     * Whether the extracted palettes should also be stored on disk.
+     *
+     * @see ImageColors::persistentCache
+     */
+    Q_PROPERTY(bool persistentCache MEMBER m_persistentCache NOTIFY persistentCacheChanged)
+
+public:
+    enum Roles {
+        PaletteRole = Qt::UserRole + 0x1000,
+        PaletteBrightnessRole,
+        AverageRole,
+        DominantRole,
+        DominantContrastRole,
+        HighlightRole,
+        ClosestToWhiteRole,
+        ClosestToBlackRole,
+    };
+    Q_ENUM(Roles)
+
+    explicit ImageColorsModel(QObject *parent = nullptr);
+    ~ImageColorsModel();
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    QStringList sources() const;
+    void setSources(const QStringList &sources);
+
+    QString sourceRole() const;
+    void setSourceRole(const QString &role);
+
+    bool prefetch() const;
+    void setPrefetch(bool prefetch);
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+Q_SIGNALS:
+    void sourcesChanged();
+    void sourceRoleChanged();
+    void prefetchChanged();
+    void persistentCacheChanged();
+
+private:
+    QString imageSource(const QModelIndex &index) const;
+    void updateSourceRole();
+    void requestPalette(const QString &source, const QModelIndex &index) const;
+    void prefetchRows(int first, int last);
+    void schedule() const;
+    void startJob(const QString &source) const;
+    void paletteReady(const QString &source, const ImageData &data);
+
+    QStringListModel *m_sourcesModel = nullptr;
+    QString m_sourceRole;
+    int m_sourceRoleId = Qt::DisplayRole;
+    bool m_prefetch = false;
+    bool m_persistentCache = false;
+
+    // Most recently used palettes; older ones are recomputed, or rather found
+    // again in the process-wide palette cache, when they get asked for again
+    QCache<QString, ImageData> m_palettes;
+
+    // Palettes are requested lazily by data(), so the scheduling state is mutable
+    // Rows waiting for the palette of a given source, to be notified once it's ready
+    mutable QHash<QString, QList<QPersistentModelIndex>> m_waitingIndexes;
+    // Sources not yet started, the first one is the most urgent
+    mutable QStringList m_queue;
+    mutable int m_runningJobs = 0;
+    QSharedPointer<ImageColorsModelRelay> m_relay;
+};
@@ -22,6 +22,7 @@
 #include "colorutils.h"
 #include "pagerouter.h"
 #include "imagecolors.h"
+#include "imagecolorsmodel.h"
 #include "avatar.h"
 #include "toolbarlayout.h"
 #include "sizegroup.h"
@@ -271,6 +272,11 @@ void KirigamiPlugin::registerTypes(const char *uri)
     qmlRegisterSingletonType<DisplayHint>(uri, 2, 14, "DisplayHint", [](QQmlEngine*, QJSEngine*) -> QObject* { return new DisplayHint; });
     qmlRegisterType<SizeGroup>(uri, 2, 14, "SizeGroup");
 
+    // 2.15
+    qmlRegisterType<ImageColorsModel>(uri, 2, 15, "ImageColorsModel");
+    qmlRegisterSingletonType<IconTextureCache>(uri, 2, 15, "IconTextureCache", [](QQmlEngine*, QJSEngine*) -> QObject* { return new IconTextureCache; });
+    qmlRegisterSingletonType<DelegateRecyclerCache>(uri, 2, 15, "DelegateRecyclerCache", [](QQmlEngine *engine, QJSEngine*) -> QObject* { return new DelegateRecyclerCache(engine); });
+
     qmlProtectModule(uri, 2);
 }
 
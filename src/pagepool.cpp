@@ -10,15 +10,104 @@
 #include <QQmlEngine>
 #include <QQmlComponent>
 #include <QQmlContext>
+#include <QQmlIncubator>
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
 #include <QQmlProperty>
+#endif
+
+#include <functional>
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+static void setInitialProperties(QObject *object, const QVariantMap &properties, QQmlContext *ctx)
+{
+    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it) {
+
+        QQmlProperty p(object, it.key(), ctx);
+        if (!p.isValid()) {
+            qWarning() << "Invalid property " << it.key();
+            continue;
+        }
+        if (!p.write(it.value())) {
+            qWarning() << "Could not set property " << it.key();
+            continue;
+        }
+    }
+}
+#endif
+
+/**
+ * Creates a page incrementally, in the idle time between frames.
+ */
+class PageIncubator : public QQmlIncubator
+{
+public:
+    PageIncubator(const QVariantMap &properties, QQmlContext *context, std::function<void(PageIncubator *, QObject *)> callback)
+        : QQmlIncubator(QQmlIncubator::Asynchronous)
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+        , m_properties(properties)
+        , m_context(context)
+#endif
+        , m_callback(callback)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        Q_UNUSED(context)
+        setInitialProperties(properties);
+#endif
+    }
+
+protected:
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+    void setInitialState(QObject *object) override
+    {
+        setInitialProperties(object, m_properties, m_context);
+    }
+#endif
+
+    void statusChanged(QQmlIncubator::Status status) override
+    {
+        if (status == QQmlIncubator::Error) {
+            qWarning() << "Could not create page" << errors();
+            m_callback(this, nullptr);
+        } else if (status == QQmlIncubator::Ready) {
+            m_callback(this, object());
+        }
+    }
+
+private:
+#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+    QVariantMap m_properties;
+    QQmlContext *m_context;
+#endif
+    std::function<void(PageIncubator *, QObject *)> m_callback;
+};
+
+// Rough memory used by a QObject of a page, QML items mostly, with their bindings
+static const qint64 s_bytesPerObject = 512;
 
 PagePool::PagePool(QObject *parent)
     : QObject(parent)
 {
+    // Pages are usually put in a PageRow right after being loaded, wait for that
+    m_evictionTimer.setSingleShot(true);
+    m_evictionTimer.setInterval(0);
+    connect(&m_evictionTimer, &QTimer::timeout, this, &PagePool::evictPages);
+
+    m_warmUpTimer.setSingleShot(true);
+    m_warmUpTimer.setInterval(0);
+    connect(&m_warmUpTimer, &QTimer::timeout, this, &PagePool::warmUpNext);
 }
 
 PagePool::~PagePool()
 {
+    if (m_warmUpIncubator) {
+        m_warmUpIncubator->clear();
+        delete m_warmUpIncubator;
+    }
+    const auto incubators = m_incubators.keys();
+    for (PageIncubator *incubator : incubators) {
+        incubator->clear();
+        delete incubator;
+    }
 }
 
 QUrl PagePool::lastLoadedUrl() const
@@ -50,6 +139,55 @@ bool PagePool::cachePages() const
     return m_cachePages;
 }
 
+bool PagePool::isAsynchronous() const
+{
+    return m_asynchronous;
+}
+
+void PagePool::setAsynchronous(bool asynchronous)
+{
+    if (asynchronous == m_asynchronous) {
+        return;
+    }
+
+    m_asynchronous = asynchronous;
+    emit asynchronousChanged();
+}
+
+int PagePool::maximumPages() const
+{
+    return m_maximumPages;
+}
+
+void PagePool::setMaximumPages(int pages)
+{
+    pages = qMax(0, pages);
+    if (pages == m_maximumPages) {
+        return;
+    }
+
+    m_maximumPages = pages;
+    scheduleEviction();
+    emit maximumPagesChanged();
+}
+
+qint64 PagePool::maximumCost() const
+{
+    return m_maximumCost;
+}
+
+void PagePool::setMaximumCost(qint64 cost)
+{
+    cost = qMax(qint64(0), cost);
+    if (cost == m_maximumCost) {
+        return;
+    }
+
+    m_maximumCost = cost;
+    scheduleEviction();
+    emit maximumCostChanged();
+}
+
 QQuickItem *PagePool::loadPage(const QString &url, QJSValue callback)
 {
     return loadPageWithProperties(url, QVariantMap(), callback);
@@ -64,10 +202,16 @@ QQuickItem *PagePool::loadPageWithProperties(
 
     const QUrl actualUrl = resolvedUrl(url);
 
+    // Being created by warmUp(), finish that instead of starting over
+    if (m_warmUpIncubator && m_warmUpIncubatorUrl == actualUrl) {
+        m_warmUpIncubator->forceCompletion();
+    }
+
     auto found = m_itemForUrl.find(actualUrl);
     if (found != m_itemForUrl.end()) {
         m_lastLoadedUrl = found.key();
         m_lastLoadedItem = found.value();
+        touchPage(actualUrl);
 
         if (callback.isCallable()) {
             QJSValueList args = {qmlEngine(this)->newQObject(found.value())};
@@ -85,9 +229,20 @@ QQuickItem *PagePool::loadPageWithProperties(
     }
 
     QQmlComponent *component = m_componentForUrl.value(actualUrl);
+    // Created for this call only, the one of m_componentForUrl is still being loaded
+    bool ownComponent = false;
 
     if (!component) {
         component = new QQmlComponent(qmlEngine(this), actualUrl, QQmlComponent::PreferSynchronous);
+    } else if (component->isLoading() && !callback.isCallable()) {
+        // Still being compiled for warmUp() or an earlier loadPage() with a callback,
+        // which are left to finish. For a local file, a synchronous component for the
+        // same file makes the engine finish compiling it right now
+        if (!isLocalUrl(actualUrl)) {
+            return nullptr;
+        }
+        component = new QQmlComponent(qmlEngine(this), actualUrl, QQmlComponent::PreferSynchronous);
+        ownComponent = true;
     }
 
     if (component->status() == QQmlComponent::Loading) {
@@ -105,31 +260,39 @@ QQuickItem *PagePool::loadPageWithProperties(
                 component->deleteLater();
                 return;
             }
+            if (m_asynchronous) {
+                incubateFromComponent(component, component->url(), properties, callback);
+                return;
+            }
             QQuickItem *item = createFromComponent(component, properties);
             if (item) {
                 QJSValueList args = {qmlEngine(this)->newQObject(item)};
                 callback.call(args);
             }
 
-            if (m_cachePages) {
-                component->deleteLater();
-            } else {
-                m_componentForUrl[component->url()] = component;
-            }
+            releaseComponent(component->url(), component);
         });
 
         return nullptr;
 
     } else if (component->status() != QQmlComponent::Ready) {
         qWarning() << component->errors();
+        if (ownComponent) {
+            component->deleteLater();
+        }
+        return nullptr;
+    }
+
+    if (m_asynchronous && callback.isCallable()) {
+        incubateFromComponent(component, actualUrl, properties, callback);
         return nullptr;
     }
 
     QQuickItem *item = createFromComponent(component, properties);
-    if (m_cachePages) {
+    if (ownComponent) {
         component->deleteLater();
     } else {
-        m_componentForUrl[component->url()] = component;
+        releaseComponent(actualUrl, component);
     }
 
     if (callback.isCallable()) {
@@ -151,29 +314,70 @@ QQuickItem *PagePool::createFromComponent(QQmlComponent *component, const QVaria
     QQmlContext *ctx = QQmlEngine::contextForObject(this);
     Q_ASSERT(ctx);
 
-    //TODO:  As soon as we can depend on Qt 5.14, use QQmlComponent::createWithInitialProperties
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    // Qt still resolves every property by name, this only saves the two step creation
+    QObject *obj = component->createWithInitialProperties(properties, ctx);
+#else
     QObject *obj = component->beginCreate(ctx);
+    if (obj) {
+        setInitialProperties(obj, properties, ctx);
+        component->completeCreate();
+    }
+#endif
 
     // Error?
     if (!obj) {
         return nullptr;
     }
 
-    for (auto it = properties.constBegin(); it != properties.constEnd(); ++it) {
+    return adoptPage(component->url(), obj);
+}
 
-        QQmlProperty p(obj, it.key(), ctx);
-        if (!p.isValid()) {
-            qWarning() << "Invalid property " << it.key();
-            continue;
+void PagePool::incubateFromComponent(QQmlComponent *component, const QUrl &url, const QVariantMap &properties, QJSValue callback)
+{
+    QQmlContext *ctx = QQmlEngine::contextForObject(this);
+    Q_ASSERT(ctx);
+
+    PageIncubator *incubator = new PageIncubator(properties, ctx, [this, component, url, callback](PageIncubator *incubator, QObject *obj) mutable {
+        // The incubator can't be deleted from its own callback
+        m_incubators.remove(incubator);
+        QMetaObject::invokeMethod(this, [incubator]() {
+            delete incubator;
+        }, Qt::QueuedConnection);
+
+        // Another instance of the page was loaded in the meantime
+        QQuickItem *item = m_cachePages ? m_itemForUrl.value(url) : nullptr;
+        if (item) {
+            delete obj;
+            m_lastLoadedItem = item;
+            touchPage(url);
+            emit lastLoadedItemChanged();
+        } else if (obj) {
+            item = adoptPage(url, obj);
         }
-        if (!p.write(it.value())) {
-            qWarning() << "Could not set property " << it.key();
-            continue;
+
+        releaseComponent(url, component);
+
+        if (item) {
+            m_lastLoadedUrl = url;
+            emit lastLoadedUrlChanged();
         }
+        // Called with null if the page could not be created, like loadPage() does
+        QJSValueList args = {qmlEngine(this)->newQObject(item)};
+        callback.call(args);
+    });
+    m_incubators.insert(incubator, component);
+    component->create(*incubator, ctx);
+
+    // Without an incubation controller, which windows install on their engine,
+    // nothing would ever drive the incubator
+    if (m_incubators.contains(incubator) && !qmlEngine(this)->incubationController()) {
+        incubator->forceCompletion();
     }
+}
 
-    component->completeCreate();
-
+QQuickItem *PagePool::adoptPage(const QUrl &url, QObject *obj)
+{
     QQuickItem *item = qobject_cast<QQuickItem *>(obj);
     if (!item) {
         obj->deleteLater();
@@ -185,7 +389,7 @@ QQuickItem *PagePool::createFromComponent(QQmlComponent *component, const QVaria
 
     if (m_cachePages) {
         QQmlEngine::setObjectOwnership(item, QQmlEngine::CppOwnership);
-        m_itemForUrl[component->url()] = item;
+        addPage(url, item);
     } else {
         QQmlEngine::setObjectOwnership(item, QQmlEngine::JavaScriptOwnership);
     }
@@ -195,6 +399,22 @@ QQuickItem *PagePool::createFromComponent(QQmlComponent *component, const QVaria
     return item;
 }
 
+void PagePool::releaseComponent(const QUrl &url, QQmlComponent *component)
+{
+    // Pages are created only once when cached, otherwise the component is needed again
+    if (m_cachePages) {
+        if (m_componentForUrl.value(url) == component) {
+            m_componentForUrl.remove(url);
+        }
+        // Other pages of the same url may still be incubating
+        if (!m_incubators.key(component)) {
+            component->deleteLater();
+        }
+    } else {
+        m_componentForUrl[url] = component;
+    }
+}
+
 QUrl PagePool::resolvedUrl(const QString &stringUrl) const
 {
     Q_ASSERT(qmlEngine(this));
@@ -266,14 +486,32 @@ void PagePool::deletePage(const QVariant &page)
         return;
     }
 
-    m_itemForUrl.remove(url);
-    m_urlForItem.remove(item);
+    removePage(item);
     item->deleteLater();
 }
 
 void PagePool::clear()
 {
+    m_warmUpQueue.clear();
+    m_warmUpPages.clear();
+    m_warmUpComponent = nullptr;
+    if (m_warmUpIncubator) {
+        m_warmUpIncubator->clear();
+        delete m_warmUpIncubator;
+        m_warmUpIncubator = nullptr;
+    }
+    // Their components are about to go as well
+    for (auto it = m_incubators.constBegin(); it != m_incubators.constEnd(); ++it) {
+        it.key()->clear();
+        delete it.key();
+        if (!m_componentForUrl.key(it.value()).isValid()) {
+            it.value()->deleteLater();
+        }
+    }
+    m_incubators.clear();
+
     for (auto *c : qAsConst(m_componentForUrl)) {
+        disconnect(c, nullptr, this, nullptr);
         c->deleteLater();
     }
     m_componentForUrl.clear();
@@ -284,10 +522,14 @@ void PagePool::clear()
             i->deleteLater();
         }
         QQmlEngine::setObjectOwnership(i, QQmlEngine::JavaScriptOwnership);
+        disconnect(i, nullptr, this, nullptr);
     }
     m_itemForUrl.clear();
 
     m_urlForItem.clear();
+    m_costForItem.clear();
+    m_loadOrder.clear();
+    m_totalCost = 0;
     m_lastLoadedUrl = QUrl();
     m_lastLoadedItem = nullptr;
     
@@ -295,4 +537,237 @@ void PagePool::clear()
     emit lastLoadedItemChanged();
 }
 
+qint64 PagePool::pageCost(const QVariant &page) const
+{
+    return m_costForItem.value(pageForVariant(page));
+}
+
+void PagePool::setPageCost(const QVariant &page, qint64 cost)
+{
+    QQuickItem *item = pageForVariant(page);
+    auto it = m_costForItem.find(item);
+    if (it == m_costForItem.end()) {
+        return;
+    }
+
+    cost = qMax(qint64(0), cost);
+    m_totalCost += cost - it.value();
+    it.value() = cost;
+    scheduleEviction();
+}
+
+QQuickItem *PagePool::pageForVariant(const QVariant &page) const
+{
+    if (page.canConvert<QQuickItem *>()) {
+        QQuickItem *item = page.value<QQuickItem *>();
+        return m_urlForItem.contains(item) ? item : nullptr;
+    } else if (page.canConvert<QString>()) {
+        return m_itemForUrl.value(resolvedUrl(page.value<QString>()));
+    }
+    return nullptr;
+}
+
+void PagePool::addPage(const QUrl &url, QQuickItem *item)
+{
+    const qint64 cost = (item->findChildren<QObject *>().count() + 1) * s_bytesPerObject;
+
+    m_itemForUrl[url] = item;
+    m_urlForItem[item] = url;
+    m_costForItem[item] = cost;
+    m_totalCost += cost;
+    m_loadOrder.append(url);
+
+    // Pages taken out of a PageRow or a layer can be evicted again
+    connect(item, &QQuickItem::parentChanged, this, [this](QQuickItem *parent) {
+        if (!parent) {
+            scheduleEviction();
+        }
+    });
+    connect(item, &QObject::destroyed, this, [this, item]() {
+        removePage(item);
+    });
+
+    scheduleEviction();
+}
+
+void PagePool::removePage(QQuickItem *item)
+{
+    auto it = m_urlForItem.find(item);
+    if (it == m_urlForItem.end()) {
+        return;
+    }
+
+    disconnect(item, nullptr, this, nullptr);
+    m_itemForUrl.remove(it.value());
+    m_loadOrder.removeOne(it.value());
+    m_totalCost -= m_costForItem.take(item);
+    m_urlForItem.erase(it);
+}
+
+void PagePool::touchPage(const QUrl &url)
+{
+    const int index = m_loadOrder.indexOf(url);
+    if (index >= 0) {
+        m_loadOrder.move(index, m_loadOrder.count() - 1);
+    }
+}
+
+bool PagePool::isOverCapacity() const
+{
+    return (m_maximumPages > 0 && m_itemForUrl.count() > m_maximumPages)
+        || (m_maximumCost > 0 && m_totalCost > m_maximumCost);
+}
+
+void PagePool::scheduleEviction()
+{
+    if (isOverCapacity()) {
+        m_evictionTimer.start();
+    }
+}
+
+void PagePool::evictPages()
+{
+    int i = 0;
+    while (isOverCapacity() && i < m_loadOrder.count()) {
+        const QUrl url = m_loadOrder.at(i);
+        QQuickItem *item = m_itemForUrl.value(url);
+        // Pages in use stay, they can be evicted once they are taken out of their parent
+        if (!item || item->parentItem() || item == m_lastLoadedItem) {
+            ++i;
+            continue;
+        }
+
+        emit pageAboutToBeEvicted(url, item);
+        // The page could have been reparented or deleted in the meantime
+        if (m_itemForUrl.value(url) != item || item->parentItem()) {
+            continue;
+        }
+
+        removePage(item);
+        item->deleteLater();
+        emit pageEvicted(url);
+    }
+}
+
+void PagePool::warmUp(const QStringList &urls, bool createPages)
+{
+    for (const QString &url : urls) {
+        const QUrl actualUrl = resolvedUrl(url);
+        if (m_itemForUrl.contains(actualUrl)) {
+            continue;
+        }
+        if (!m_warmUpQueue.contains(actualUrl)) {
+            m_warmUpQueue.append(actualUrl);
+        }
+        if (createPages) {
+            m_warmUpPages.insert(actualUrl);
+        }
+    }
+
+    m_warmUpTimer.start();
+}
+
+void PagePool::warmUpNext()
+{
+    // One page at a time, to leave the application some room
+    if (m_warmUpComponent || m_warmUpIncubator) {
+        return;
+    }
+
+    while (!m_warmUpQueue.isEmpty()) {
+        const QUrl url = m_warmUpQueue.takeFirst();
+        if (m_itemForUrl.contains(url)) {
+            m_warmUpPages.remove(url);
+            continue;
+        }
+
+        QQmlComponent *component = m_componentForUrl.value(url);
+        if (!component) {
+            component = new QQmlComponent(qmlEngine(this), url, QQmlComponent::Asynchronous, this);
+            m_componentForUrl[url] = component;
+        }
+
+        if (component->isLoading()) {
+            m_warmUpComponent = component;
+            // loadPage() may connect callbacks to the same component in the meantime
+            m_warmUpConnection = connect(component, &QQmlComponent::statusChanged, this, [this, component]() {
+                if (component->isLoading()) {
+                    return;
+                }
+                disconnect(m_warmUpConnection);
+                if (component == m_warmUpComponent) {
+                    m_warmUpComponent = nullptr;
+                }
+                warmUpComponent(component);
+            });
+        } else {
+            warmUpComponent(component);
+        }
+        return;
+    }
+}
+
+void PagePool::warmUpComponent(QQmlComponent *component)
+{
+    const QUrl url = m_componentForUrl.key(component);
+
+    if (component->isError()) {
+        qWarning() << component->errors();
+        m_componentForUrl.remove(url);
+        m_warmUpPages.remove(url);
+        component->deleteLater();
+        m_warmUpTimer.start();
+        return;
+    }
+
+    // Loaded for real in the meantime: like loadPage(), the component isn't needed anymore
+    if (m_cachePages && m_itemForUrl.contains(url)) {
+        m_warmUpPages.remove(url);
+        m_componentForUrl.remove(url);
+        component->deleteLater();
+        emit pageWarmedUp(url);
+        m_warmUpTimer.start();
+        return;
+    }
+
+    if (!m_warmUpPages.remove(url) || !m_cachePages) {
+        emit pageWarmedUp(url);
+        m_warmUpTimer.start();
+        return;
+    }
+
+    m_warmUpIncubatorUrl = url;
+    m_warmUpIncubator = new PageIncubator(QVariantMap(), QQmlEngine::contextForObject(this), [this, url](PageIncubator *incubator, QObject *obj) {
+        // The incubator can't be deleted from its own callback
+        m_warmUpIncubator = nullptr;
+        QMetaObject::invokeMethod(this, [incubator]() {
+            delete incubator;
+        }, Qt::QueuedConnection);
+
+        QQuickItem *item = qobject_cast<QQuickItem *>(obj);
+        // Loaded for real in the meantime
+        if (!item || !m_cachePages || m_itemForUrl.contains(url)) {
+            delete obj;
+        } else {
+            QQmlEngine::setObjectOwnership(item, QQmlEngine::CppOwnership);
+            addPage(url, item);
+            // Like loadPage(), the component isn't needed anymore
+            QQmlComponent *component = m_componentForUrl.take(url);
+            if (component) {
+                component->deleteLater();
+            }
+        }
+
+        emit pageWarmedUp(url);
+        m_warmUpTimer.start();
+    });
+    component->create(*m_warmUpIncubator, QQmlEngine::contextForObject(this));
+
+    // Without an incubation controller, which windows install on their engine,
+    // nothing would ever drive the incubator
+    if (m_warmUpIncubator && !qmlEngine(this)->incubationController()) {
+        m_warmUpIncubator->forceCompletion();
+    }
+}
+
 #include "moc_pagepool.cpp"
@@ -8,6 +8,10 @@
 #include <QObject>
 #include <QQuickItem>
 #include <QPointer>
+#include <QSet>
+#include <QTimer>
+
+class PageIncubator;
 
 /**
  * A Pool of Page items, pages will be unique per url and the items
@@ -38,6 +42,45 @@ class PagePool : public QObject
      */
     Q_PROPERTY(bool cachePages READ cachePages WRITE setCachePages NOTIFY cachePagesChanged)
 
+    /**
+     * The most pages the pool keeps around when cachePages is true, 0 for no limit.
+     *
+     * Over capacity, the least recently loaded pages are deleted first. Pages
+     * currently in a PageRow, a layer stack or any other parent item are never
+     * deleted, nor is the last loaded one.
+     *
+     * default: ``0``
+     *
+     * @see maximumCost
+     * @since 2.15
+     */
+    Q_PROPERTY(int maximumPages READ maximumPages WRITE setMaximumPages NOTIFY maximumPagesChanged)
+
+    /**
+     * The most memory, in bytes, pages kept around by the pool can use, 0 for no limit.
+     *
+     * The memory of a page is estimated from the number of objects in it when
+     * it's created, unless set with setPageCost(). Pages are deleted as with
+     * maximumPages.
+     *
+     * default: ``0``
+     *
+     * @since 2.15
+     */
+    Q_PROPERTY(qint64 maximumCost READ maximumCost WRITE setMaximumCost NOTIFY maximumCostChanged)
+
+    /**
+     * When true, pages loaded with a callback are created incrementally over
+     * several frames, and passed to the callback once ready.
+     *
+     * Pages loaded without a callback are always created right away.
+     *
+     * default: ``false``
+     *
+     * @since 2.15
+     */
+    Q_PROPERTY(bool asynchronous READ isAsynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
+
 public:
     PagePool(QObject *parent = nullptr);
     ~PagePool();
@@ -48,6 +91,15 @@ public:
     void setCachePages(bool cache);
     bool cachePages() const;
 
+    int maximumPages() const;
+    void setMaximumPages(int pages);
+
+    qint64 maximumCost() const;
+    void setMaximumCost(qint64 cost);
+
+    bool isAsynchronous() const;
+    void setAsynchronous(bool asynchronous);
+
     /**
      * Returns the instance of the item defined in the QML file identified
      * by url, only one instance will be made per url if cachePAges is true. If the url is remote (i.e. http) don't rely on the return value but us the async callback instead
@@ -55,13 +107,19 @@ public:
      *       an absolute path
      *       or a relative one to the path of the qml file the PagePool is instantiated from
      * @param callback If we are loading a remote url, we can't have the item immediately but will be passed as a parameter to the provided callback.
-     * Normally, don't set a callback, use it only in case of remote urls.
+     * Normally, don't set a callback, use it only in case of remote urls, or to create pages in several frames when asynchronous is true.
      * @returns the page instance that will have been created if necessary.
      *          If the url is remote it will return null,
      *          as well will return null if the callback has been provided
      */
     Q_INVOKABLE QQuickItem *loadPage(const QString &url, QJSValue callback = QJSValue());
 
+    /**
+     * Same as loadPage(), setting @p properties on the page when it's created.
+     *
+     * Properties are set in one step with the creation of the page, before its
+     * bindings are evaluated. They are ignored if the page was already created.
+     */
     Q_INVOKABLE QQuickItem *loadPageWithProperties(
             const QString &url, const QVariantMap &properties, QJSValue callback = QJSValue());
 
@@ -103,20 +161,115 @@ public:
      */
     Q_INVOKABLE void clear();
 
+    /**
+     * @returns the estimated memory used by a page of the pool, in bytes
+     * @param page either the url or the instance of the page
+     * @since 2.15
+     */
+    Q_INVOKABLE qint64 pageCost(const QVariant &page) const;
+
+    /**
+     * Replaces the estimated memory used by a page of the pool, for instance
+     * to account for the images or models it holds.
+     * @param page either the url or the instance of the page
+     * @param cost the memory used by the page, in bytes
+     * @since 2.15
+     */
+    Q_INVOKABLE void setPageCost(const QVariant &page, qint64 cost);
+
+    /**
+     * Prepares pages ahead of time, so loading them later is quick.
+     *
+     * The QML files are compiled one after the other, asynchronously, in the
+     * idle time of the application. Loading one of these pages then only costs
+     * its creation, unless it's loaded before its file is ready.
+     *
+     * @code{.qml}
+     * Kirigami.PagePool {
+     *     id: pool
+     *     Component.onCompleted: warmUp(["SettingsPage.qml", "AboutPage.qml"])
+     * }
+     * @endcode
+     *
+     * @param urls the urls of the pages, as for loadPage()
+     * @param createPages if true and cachePages is true, also create an instance
+     *        of every page, incrementally over several frames, ready to be shown
+     *        by the next loadPage()
+     * @see pageWarmedUp
+     * @since 2.15
+     */
+    Q_INVOKABLE void warmUp(const QStringList &urls, bool createPages = false);
+
 Q_SIGNALS:
     void lastLoadedUrlChanged();
     void lastLoadedItemChanged();
     void cachePagesChanged();
+    void maximumPagesChanged();
+    void maximumCostChanged();
+    void asynchronousChanged();
+
+    /**
+     * Emitted before a page is deleted to stay within maximumPages or maximumCost,
+     * while it can still be used, for instance to save its state.
+     * @since 2.15
+     */
+    void pageAboutToBeEvicted(const QUrl &url, QQuickItem *page);
+
+    /**
+     * Emitted once a page has been removed from the pool to stay within
+     * maximumPages or maximumCost. The page itself is deleted shortly after.
+     * @since 2.15
+     */
+    void pageEvicted(const QUrl &url);
+
+    /**
+     * Emitted when the page at @p url asked for by warmUp() is compiled, and
+     * created if requested.
+     * @since 2.15
+     */
+    void pageWarmedUp(const QUrl &url);
 
 private:
     QQuickItem *createFromComponent(QQmlComponent *component, const QVariantMap &properties);
+    void incubateFromComponent(QQmlComponent *component, const QUrl &url, const QVariantMap &properties, QJSValue callback);
+    QQuickItem *adoptPage(const QUrl &url, QObject *obj);
+    void releaseComponent(const QUrl &url, QQmlComponent *component);
+    QQuickItem *pageForVariant(const QVariant &page) const;
+    void addPage(const QUrl &url, QQuickItem *item);
+    void removePage(QQuickItem *item);
+    void touchPage(const QUrl &url);
+    bool isOverCapacity() const;
+    void scheduleEviction();
+    void evictPages();
+    void warmUpNext();
+    void warmUpComponent(QQmlComponent *component);
 
     QUrl m_lastLoadedUrl;
     QPointer <QQuickItem> m_lastLoadedItem;
     QHash<QUrl, QQuickItem *> m_itemForUrl;
     QHash<QUrl, QQmlComponent *> m_componentForUrl;
     QHash<QQuickItem *, QUrl> m_urlForItem;
+    QHash<QQuickItem *, qint64> m_costForItem;
+    // Urls of the pages, the least recently loaded first
+    QList<QUrl> m_loadOrder;
+    qint64 m_totalCost = 0;
+    int m_maximumPages = 0;
+    qint64 m_maximumCost = 0;
+    QTimer m_evictionTimer;
+
+    // Urls to warm up, the first one next
+    QList<QUrl> m_warmUpQueue;
+    // Urls to create a page for once compiled
+    QSet<QUrl> m_warmUpPages;
+    QTimer m_warmUpTimer;
+    QPointer<QQmlComponent> m_warmUpComponent;
+    QMetaObject::Connection m_warmUpConnection;
+    PageIncubator *m_warmUpIncubator = nullptr;
+    QUrl m_warmUpIncubatorUrl;
+    // Pages created by loadPage() when asynchronous, with their component
+    QHash<PageIncubator *, QQmlComponent *> m_incubators;
 
     bool m_cachePages = true;
+    bool m_asynchronous = false;
 };
 
@@ -7,6 +7,110 @@
  */
 
 #include "managedtexturenode.h"
+#include "textureatlas.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QTimer>
+
+// How long released textures are kept around in case they are needed again, in milliseconds
+static const qint64 s_releasedTextureLifetime = 5000;
+static const qint64 s_defaultMemoryBudget = 64 * 1024 * 1024;
+
+typedef QHash<qint64, QHash<QWindow*, QWeakPointer<QSGTexture> > > TexturesCache;
+
+struct ReleasedTexture
+{
+    qint64 id;
+    QQuickWindow *window;
+    QSGTexture *texture;
+    qint64 bytes;
+    qint64 releaseTime;
+};
+
+struct ImageTexturesCachePrivate
+{
+    QSGTexture *takeReleased(qint64 id, QQuickWindow *window);
+    void trim(QQuickWindow *window);
+    void scheduleTrim(QQuickWindow *window);
+
+    // Windows render in threads of their own: everything but the counters is guarded by it
+    QMutex mutex;
+    TexturesCache cache;
+    QHash<QQuickWindow*, TextureAtlas*> atlases;
+    QSet<QQuickWindow*> windows;
+    // Textures nothing uses anymore, the least recently used first
+    QList<ReleasedTexture> released;
+    // Windows which will render again once their released textures expired
+    QSet<QQuickWindow*> trimScheduled;
+    QElapsedTimer clock;
+
+    QAtomicInteger<qint64> budget;
+    QAtomicInteger<qint64> hits;
+    QAtomicInteger<qint64> misses;
+    QAtomicInteger<qint64> evictions;
+    QAtomicInteger<qint64> bytes;
+    QAtomicInteger<qint64> releasedBytes;
+};
+
+QSGTexture *ImageTexturesCachePrivate::takeReleased(qint64 id, QQuickWindow *window)
+{
+    for (auto it = released.begin(); it != released.end(); ++it) {
+        if (it->id == id && it->window == window) {
+            QSGTexture *texture = it->texture;
+            releasedBytes -= it->bytes;
+            released.erase(it);
+            return texture;
+        }
+    }
+    return nullptr;
+}
+
+void ImageTexturesCachePrivate::trim(QQuickWindow *window)
+{
+    // Textures can only be deleted in the render thread of their window
+    const qint64 now = clock.elapsed();
+    bool remaining = false;
+    for (auto it = released.begin(); it != released.end();) {
+        const bool overBudget = bytes + releasedBytes > budget;
+        if (it->window == window && (overBudget || now - it->releaseTime > s_releasedTextureLifetime)) {
+            delete it->texture;
+            releasedBytes -= it->bytes;
+            ++evictions;
+            it = released.erase(it);
+        } else {
+            remaining = remaining || it->window == window;
+            ++it;
+        }
+    }
+
+    if (remaining) {
+        scheduleTrim(window);
+    }
+}
+
+void ImageTexturesCachePrivate::scheduleTrim(QQuickWindow *window)
+{
+    if (trimScheduled.contains(window)) {
+        return;
+    }
+    trimScheduled.insert(window);
+
+    // A window with nothing changing doesn't render, and wouldn't get trimmed after
+    // rendering: make it render once the textures released so far expired
+    QMetaObject::invokeMethod(window, [this, window]() {
+        QTimer::singleShot(s_releasedTextureLifetime + 100, window, [this, window]() {
+            {
+                QMutexLocker locker(&mutex);
+                trimScheduled.remove(window);
+            }
+            window->update();
+        });
+    }, Qt::QueuedConnection);
+}
 
 ManagedTextureNode::ManagedTextureNode()
 {}
@@ -15,32 +119,157 @@ void ManagedTextureNode::setTexture(QSharedPointer<QSGTexture> texture)
 {
     m_texture = texture;
     QSGSimpleTextureNode::setTexture(texture.data());
+
+    // Atlas textures can move around when their page gets defragmented
+    auto atlasTexture = dynamic_cast<AtlasTexture *>(texture.data());
+    m_atlasGeneration = atlasTexture ? atlasTexture->generation() : -1;
+    setFlag(QSGNode::UsePreprocess, atlasTexture);
+}
+
+void ManagedTextureNode::preprocess()
+{
+    auto atlasTexture = dynamic_cast<AtlasTexture *>(m_texture.data());
+    if (atlasTexture && atlasTexture->generation() != m_atlasGeneration) {
+        m_atlasGeneration = atlasTexture->generation();
+        // Updates the texture coordinates
+        QSGSimpleTextureNode::setTexture(atlasTexture);
+    }
 }
 
 ImageTexturesCache::ImageTexturesCache()
     : d(new ImageTexturesCachePrivate)
 {
+    d->clock.start();
+
+    bool ok = false;
+    const qint64 budget = qEnvironmentVariableIntValue("KIRIGAMI_TEXTURE_CACHE_BUDGET", &ok);
+    d->budget = ok && budget >= 0 ? budget * 1024 * 1024 : s_defaultMemoryBudget;
 }
 
 ImageTexturesCache::~ImageTexturesCache()
 {
+    QMutexLocker locker(&d->mutex);
+    // Released textures are left alone: by now their contexts are gone
+    qDeleteAll(d->atlases);
+}
+
+// Called with the mutex locked
+TextureAtlas *ImageTexturesCache::atlas(QQuickWindow *window)
+{
+    TextureAtlas *atlas = d->atlases.value(window);
+    if (!atlas) {
+        atlas = new TextureAtlas(window);
+        d->atlases.insert(window, atlas);
+    }
+    return atlas;
+}
+
+qint64 ImageTexturesCache::memoryBudget() const
+{
+    return d->budget;
+}
+
+void ImageTexturesCache::setMemoryBudget(qint64 bytes)
+{
+    // Applied the next time each window renders or looks for a texture
+    d->budget = bytes;
+}
+
+ImageTexturesCache::Statistics ImageTexturesCache::statistics() const
+{
+    Statistics statistics;
+    statistics.hits = d->hits;
+    statistics.misses = d->misses;
+    statistics.evictions = d->evictions;
+    statistics.bytes = d->bytes;
+    statistics.releasedBytes = d->releasedBytes;
+
+    QMutexLocker locker(&d->mutex);
+    for (TextureAtlas *atlas : qAsConst(d->atlases)) {
+        statistics.atlasBytes += atlas->memoryUsage();
+    }
+    return statistics;
 }
 
 QSharedPointer<QSGTexture> ImageTexturesCache::loadTexture(QQuickWindow *window, const QImage &image, QQuickWindow::CreateTextureOptions options)
 {
     qint64 id = image.cacheKey();
-    QSharedPointer<QSGTexture> texture = d->cache.value(id).value(window).toStrongRef();
-
-    if (!texture) {
-        auto cleanAndDelete = [this, window, id](QSGTexture* texture) {
-            QHash<QWindow*, QWeakPointer<QSGTexture> >& textures = (d->cache)[id];
-            textures.remove(window);
-            if (textures.isEmpty())
-                d->cache.remove(id);
-            delete texture;
-        };
-        texture = QSharedPointer<QSGTexture>(window->createTextureFromImage(image, options), cleanAndDelete);
-        (d->cache)[id][window] = texture.toWeakRef();
+    QSharedPointer<QSGTexture> texture;
+
+    {
+        QMutexLocker locker(&d->mutex);
+        texture = d->cache.value(id).value(window).toStrongRef();
+
+        if (!d->windows.contains(window)) {
+            d->windows.insert(window);
+            // Released textures expire even when nothing gets loaded: check them after every frame
+            QObject::connect(window, &QQuickWindow::afterRendering, window, [this, window]() {
+                QMutexLocker locker(&d->mutex);
+                d->trim(window);
+            }, Qt::DirectConnection);
+            // Emitted in the render thread, with the context still current to release the textures
+            QObject::connect(window, &QQuickWindow::sceneGraphInvalidated, window, [this, window]() {
+                QMutexLocker locker(&d->mutex);
+                for (auto it = d->released.begin(); it != d->released.end();) {
+                    if (it->window == window) {
+                        delete it->texture;
+                        d->releasedBytes -= it->bytes;
+                        it = d->released.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                delete d->atlases.take(window);
+                d->windows.remove(window);
+            }, Qt::DirectConnection);
+            // The timer making it render again goes away with it, and another window may get its address
+            QObject::connect(window, &QObject::destroyed, [this, window]() {
+                QMutexLocker locker(&d->mutex);
+                d->trimScheduled.remove(window);
+                d->windows.remove(window);
+            });
+        }
+
+        if (texture) {
+            ++d->hits;
+        } else {
+            QSGTexture *created = d->takeReleased(id, window);
+            if (created) {
+                ++d->hits;
+            } else {
+                ++d->misses;
+                if ((options & QQuickWindow::TextureCanUseAtlas) && TextureAtlas::canUseAtlas(window, image)) {
+                    created = atlas(window)->createTexture(image);
+                }
+                if (!created) {
+                    created = window->createTextureFromImage(image, options);
+                }
+            }
+
+            const qint64 bytes = qint64(created->textureSize().width()) * created->textureSize().height() * 4;
+            d->bytes += bytes;
+
+            // Rather than deleting it, keep the texture around for a while, a delegate scrolling back
+            // into view is likely to need it again
+            auto release = [this, window, id, bytes](QSGTexture* texture) {
+                QMutexLocker locker(&d->mutex);
+                QHash<QWindow*, QWeakPointer<QSGTexture> >& textures = (d->cache)[id];
+                // The entry may already belong to a texture created again for the same image
+                if (textures.value(window).isNull()) {
+                    textures.remove(window);
+                }
+                if (textures.isEmpty())
+                    d->cache.remove(id);
+                d->bytes -= bytes;
+                d->releasedBytes += bytes;
+                d->released << ReleasedTexture{id, window, texture, bytes, d->clock.elapsed()};
+                d->trim(window);
+            };
+            texture = QSharedPointer<QSGTexture>(created, release);
+            (d->cache)[id][window] = texture.toWeakRef();
+        }
+
+        d->trim(window);
     }
 
     //if we have a cache in an atlas but our request cannot use an atlassed texture
@@ -13,6 +13,8 @@
 #include <QSGTexture>
 #include <QSharedPointer>
 
+class TextureAtlas;
+
 class ManagedTextureNode : public QSGSimpleTextureNode
 {
 Q_DISABLE_COPY(ManagedTextureNode)
@@ -21,20 +23,34 @@ public:
 
     void setTexture(QSharedPointer<QSGTexture> texture);
 
+    void preprocess() override;
+
 private:
     QSharedPointer<QSGTexture> m_texture;
+    // Position of the texture in its atlas page the geometry was computed for
+    int m_atlasGeneration = -1;
 };
 
-typedef QHash<qint64, QHash<QWindow*, QWeakPointer<QSGTexture> > > TexturesCache;
-
-struct ImageTexturesCachePrivate
-{
-    TexturesCache cache;
-};
+struct ImageTexturesCachePrivate;
 
 class ImageTexturesCache
 {
 public:
+    struct Statistics {
+        /// Textures found in the cache, either in use or recently released
+        qint64 hits = 0;
+        /// Textures which had to be created
+        qint64 misses = 0;
+        /// Released textures deleted to stay in the budget or because they weren't needed again in time
+        qint64 evictions = 0;
+        /// Estimated memory used by the textures in use
+        qint64 bytes = 0;
+        /// Estimated memory used by the released textures still around
+        qint64 releasedBytes = 0;
+        /// Memory used by the atlas pages of all windows, the images in them are also counted above
+        qint64 atlasBytes = 0;
+    };
+
     ImageTexturesCache();
     ~ImageTexturesCache();
 
@@ -43,13 +59,35 @@ public:
      *
      * If an @p image id is the same as one already provided before, we won't create
      * a new texture and return a shared pointer to the existing texture.
+     *
+     * If @p options allow it, small images are placed in a texture atlas shared
+     * with the other small images of the window, so they can be drawn together.
      */
     QSharedPointer<QSGTexture> loadTexture(QQuickWindow *window, const QImage &image, QQuickWindow::CreateTextureOptions options);
 
     QSharedPointer<QSGTexture> loadTexture(QQuickWindow *window, const QImage &image);
 
+    /**
+     * The memory textures can use, in bytes.
+     *
+     * Textures still in use are never deleted, but released ones are only kept
+     * around, in case they are needed again shortly, as long as the total stays
+     * within the budget. They are checked after every frame of their window.
+     *
+     * Defaults to 64 MiB, or to the amount of MiB in the KIRIGAMI_TEXTURE_CACHE_BUDGET
+     * environment variable.
+     */
+    qint64 memoryBudget() const;
+    void setMemoryBudget(qint64 bytes);
+
+    /**
+     * Counters of the cache activity. Can be called from any thread.
+     */
+    Statistics statistics() const;
 
 private:
+    TextureAtlas *atlas(QQuickWindow *window);
+
     QScopedPointer<ImageTexturesCachePrivate> d;
 };
 
@@ -0,0 +1,421 @@
+/*
+ *  SPDX-FileCopyrightText: 2020 The KDE Community
+ *
+ *  SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include "textureatlas.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QQuickWindow>
+#include <QSGRendererInterface>
+
+#include <algorithm>
+#include <cstring>
+
+// Images bigger than this, in device pixels, get a texture of their own
+static const int s_maxImageSize = 64;
+static const QSize s_pageSize(1024, 1024);
+static const int s_maxPages = 4;
+// Transparent border around every image, so linear filtering doesn't pick up the neighbours
+static const int s_padding = 1;
+// Shelves are a multiple of this tall, so images of close sizes share them
+static const int s_shelfGranularity = 8;
+
+ShelfPacker::ShelfPacker(const QSize &size)
+    : m_size(size)
+{
+}
+
+bool ShelfPacker::place(const QSize &size, QPoint *position)
+{
+    if (size.width() > m_size.width() || size.height() > m_size.height()) {
+        return false;
+    }
+
+    for (Shelf &shelf : m_shelves) {
+        // Don't waste a tall shelf for a small image, unless nothing else is using it
+        if (shelf.height < size.height() || (shelf.slots > 0 && shelf.height >= size.height() + s_shelfGranularity)) {
+            continue;
+        }
+        for (int i = 0; i < shelf.free.count(); ++i) {
+            Span &span = shelf.free[i];
+            if (span.width < size.width()) {
+                continue;
+            }
+            *position = QPoint(span.x, shelf.y);
+            span.x += size.width();
+            span.width -= size.width();
+            if (span.width == 0) {
+                shelf.free.remove(i);
+            }
+            ++shelf.slots;
+            return true;
+        }
+    }
+
+    const int height = qMin(m_size.height(), (size.height() + s_shelfGranularity - 1) / s_shelfGranularity * s_shelfGranularity);
+    if (m_nextY + height > m_size.height()) {
+        return false;
+    }
+
+    Shelf shelf;
+    shelf.y = m_nextY;
+    shelf.height = height;
+    shelf.slots = 1;
+    if (size.width() < m_size.width()) {
+        shelf.free << Span{size.width(), m_size.width() - size.width()};
+    }
+    m_shelves << shelf;
+    m_nextY += height;
+
+    *position = QPoint(0, shelf.y);
+    return true;
+}
+
+void ShelfPacker::release(const QRect &rect)
+{
+    auto shelf = std::find_if(m_shelves.begin(), m_shelves.end(), [&rect](const Shelf &shelf) {
+        return shelf.y == rect.y();
+    });
+    if (shelf == m_shelves.end()) {
+        return;
+    }
+
+    // Keep the free spans sorted and merged with their neighbours
+    auto next = std::find_if(shelf->free.begin(), shelf->free.end(), [&rect](const Span &span) {
+        return span.x > rect.x();
+    });
+    next = shelf->free.insert(next, Span{rect.x(), rect.width()});
+    if (next + 1 != shelf->free.end() && next->x + next->width == (next + 1)->x) {
+        next->width += (next + 1)->width;
+        shelf->free.erase(next + 1);
+    }
+    if (next != shelf->free.begin() && (next - 1)->x + (next - 1)->width == next->x) {
+        (next - 1)->width += next->width;
+        shelf->free.erase(next);
+    }
+    --shelf->slots;
+
+    // Give the empty shelves at the bottom back to the page
+    while (!m_shelves.isEmpty() && m_shelves.last().slots == 0) {
+        m_nextY = m_shelves.last().y;
+        m_shelves.removeLast();
+    }
+}
+
+TextureAtlasPage::TextureAtlasPage(QQuickWindow *window, const QSize &size)
+    : m_window(window)
+    , m_context(QOpenGLContext::currentContext())
+    , m_size(size)
+    , m_packer(size)
+{
+    QOpenGLFunctions *functions = m_context->functions();
+    functions->glGenTextures(1, &m_textureId);
+    functions->glBindTexture(GL_TEXTURE_2D, m_textureId);
+    functions->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_size.width(), m_size.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+TextureAtlasPage::~TextureAtlasPage()
+{
+}
+
+void TextureAtlasPage::invalidate()
+{
+    // Without its context the texture went away with it, in any other one the id means something else
+    if (m_textureId && m_context && QOpenGLContext::currentContext() == m_context) {
+        m_context->functions()->glDeleteTextures(1, &m_textureId);
+    }
+    m_textureId = 0;
+}
+
+int TextureAtlasPage::allocate(const QImage &image)
+{
+    QPoint position;
+    if (!m_packer.place(image.size() + QSize(s_padding * 2, s_padding * 2), &position)) {
+        return -1;
+    }
+    return addSlot(image, position);
+}
+
+int TextureAtlasPage::addSlot(const QImage &image, const QPoint &position)
+{
+    int slot;
+    if (m_freeSlots.isEmpty()) {
+        slot = m_slots.count();
+        m_slots.resize(slot + 1);
+    } else {
+        slot = m_freeSlots.takeLast();
+    }
+
+    m_slots[slot].rect = QRect(position + QPoint(s_padding, s_padding), image.size());
+    m_slots[slot].image = image;
+    m_usedArea += (image.width() + s_padding * 2) * (image.height() + s_padding * 2);
+    ++m_liveSlots;
+
+    upload(m_slots[slot]);
+    return slot;
+}
+
+void TextureAtlasPage::release(int slot)
+{
+    Slot &released = m_slots[slot];
+    const QRect padded = released.rect.adjusted(-s_padding, -s_padding, s_padding, s_padding);
+    m_packer.release(padded);
+    m_usedArea -= padded.width() * padded.height();
+    --m_liveSlots;
+
+    released = Slot();
+    m_freeSlots << slot;
+}
+
+int TextureAtlasPage::defragmentAndAllocate(const QImage &image)
+{
+    // The new image is packed along with the others, at index -1
+    QVector<int> slots;
+    slots << -1;
+    for (int i = 0; i < m_slots.count(); ++i) {
+        if (!m_slots[i].image.isNull()) {
+            slots << i;
+        }
+    }
+
+    auto height = [this, &image](int slot) {
+        return slot < 0 ? image.height() : m_slots[slot].rect.height();
+    };
+
+    // Tallest first, so the shelves are as full as they can be
+    std::stable_sort(slots.begin(), slots.end(), [&height](int a, int b) {
+        return height(a) > height(b);
+    });
+
+    // Only move things around if everything, the new image included, fits in the new layout
+    ShelfPacker packer(m_size);
+    QVector<QPoint> positions;
+    positions.reserve(slots.count());
+    for (int slot : qAsConst(slots)) {
+        const QSize size = slot < 0 ? image.size() : m_slots[slot].rect.size();
+        QPoint position;
+        if (!packer.place(size + QSize(s_padding * 2, s_padding * 2), &position)) {
+            return -1;
+        }
+        positions << position;
+    }
+
+    m_packer = packer;
+    QPoint imagePosition;
+    for (int i = 0; i < slots.count(); ++i) {
+        if (slots[i] < 0) {
+            imagePosition = positions[i];
+            continue;
+        }
+        Slot &slot = m_slots[slots[i]];
+        slot.rect.moveTopLeft(positions[i] + QPoint(s_padding, s_padding));
+        upload(slot);
+    }
+    ++m_generation;
+
+    return addSlot(image, imagePosition);
+}
+
+bool TextureAtlasPage::isEmpty() const
+{
+    return m_liveSlots == 0;
+}
+
+bool TextureAtlasPage::isFragmented(const QSize &size) const
+{
+    // Plenty of room overall, just not in the right places
+    const int needed = (size.width() + s_padding * 2) * (size.height() + s_padding * 2);
+    return m_usedArea + needed <= m_size.width() * m_size.height() * 0.7;
+}
+
+QRect TextureAtlasPage::slotRect(int slot) const
+{
+    return m_slots[slot].rect;
+}
+
+QImage TextureAtlasPage::slotImage(int slot) const
+{
+    return m_slots[slot].image;
+}
+
+QQuickWindow *TextureAtlasPage::window() const
+{
+    return m_window;
+}
+
+QSize TextureAtlasPage::size() const
+{
+    return m_size;
+}
+
+int TextureAtlasPage::textureId() const
+{
+    return m_textureId;
+}
+
+int TextureAtlasPage::generation() const
+{
+    return m_generation;
+}
+
+void TextureAtlasPage::bind()
+{
+    QOpenGLContext::currentContext()->functions()->glBindTexture(GL_TEXTURE_2D, m_textureId);
+}
+
+void TextureAtlasPage::upload(const Slot &slot)
+{
+    // The padding is uploaded as well, to clear what a previous image may have left there
+    QImage padded(slot.rect.size() + QSize(s_padding * 2, s_padding * 2), QImage::Format_RGBA8888_Premultiplied);
+    padded.fill(Qt::transparent);
+    const QImage image = slot.image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
+    for (int y = 0; y < image.height(); ++y) {
+        std::memcpy(padded.scanLine(y + s_padding) + s_padding * 4, image.constScanLine(y), image.width() * 4);
+    }
+
+    QOpenGLFunctions *functions = QOpenGLContext::currentContext()->functions();
+    functions->glBindTexture(GL_TEXTURE_2D, m_textureId);
+    functions->glTexSubImage2D(GL_TEXTURE_2D, 0, slot.rect.x() - s_padding, slot.rect.y() - s_padding,
+                               padded.width(), padded.height(), GL_RGBA, GL_UNSIGNED_BYTE, padded.constBits());
+}
+
+AtlasTexture::AtlasTexture(const QSharedPointer<TextureAtlasPage> &page, int slot)
+    : m_page(page)
+    , m_slot(slot)
+{
+}
+
+AtlasTexture::~AtlasTexture()
+{
+    m_page->release(m_slot);
+}
+
+int AtlasTexture::textureId() const
+{
+    return m_page->textureId();
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+int AtlasTexture::comparisonKey() const
+{
+    return m_page->textureId();
+}
+#endif
+
+QSize AtlasTexture::textureSize() const
+{
+    return m_page->slotRect(m_slot).size();
+}
+
+bool AtlasTexture::hasAlphaChannel() const
+{
+    return m_page->slotImage(m_slot).hasAlphaChannel();
+}
+
+bool AtlasTexture::hasMipmaps() const
+{
+    return false;
+}
+
+QRectF AtlasTexture::normalizedTextureSubRect() const
+{
+    const QRectF rect = m_page->slotRect(m_slot);
+    const QSizeF size = m_page->size();
+    return QRectF(rect.x() / size.width(), rect.y() / size.height(),
+                  rect.width() / size.width(), rect.height() / size.height());
+}
+
+bool AtlasTexture::isAtlasTexture() const
+{
+    return true;
+}
+
+QSGTexture *AtlasTexture::removedFromAtlas() const
+{
+    if (!m_standalone) {
+        m_standalone.reset(m_page->window()->createTextureFromImage(m_page->slotImage(m_slot)));
+        m_standalone->setFiltering(filtering());
+    }
+    return m_standalone.data();
+}
+
+void AtlasTexture::bind()
+{
+    m_page->bind();
+    // Other textures of the page may have set other options
+    updateBindOptions(true);
+}
+
+int AtlasTexture::generation() const
+{
+    return m_page->generation();
+}
+
+TextureAtlas::TextureAtlas(QQuickWindow *window)
+    : m_window(window)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    // Textures still using the pages keep them alive, but not their OpenGL texture
+    for (const auto &page : qAsConst(m_pages)) {
+        page->invalidate();
+    }
+}
+
+bool TextureAtlas::canUseAtlas(QQuickWindow *window, const QImage &image)
+{
+    return !image.isNull()
+        && image.width() <= s_maxImageSize && image.height() <= s_maxImageSize
+        && window->rendererInterface()->graphicsApi() == QSGRendererInterface::OpenGL
+        && QOpenGLContext::currentContext();
+}
+
+QSGTexture *TextureAtlas::createTexture(const QImage &image)
+{
+    // Drop the pages nothing uses anymore, but keep one around for the next images
+    for (int i = m_pages.count() - 1; i >= 0 && m_pages.count() > 1; --i) {
+        if (m_pages[i]->isEmpty()) {
+            m_pages[i]->invalidate();
+            m_pages.remove(i);
+        }
+    }
+
+    for (const auto &page : qAsConst(m_pages)) {
+        const int slot = page->allocate(image);
+        if (slot >= 0) {
+            return new AtlasTexture(page, slot);
+        }
+    }
+
+    for (const auto &page : qAsConst(m_pages)) {
+        if (page->isFragmented(image.size())) {
+            const int slot = page->defragmentAndAllocate(image);
+            if (slot >= 0) {
+                return new AtlasTexture(page, slot);
+            }
+        }
+    }
+
+    if (m_pages.count() >= s_maxPages) {
+        return nullptr;
+    }
+
+    QSharedPointer<TextureAtlasPage> page(new TextureAtlasPage(m_window, s_pageSize));
+    m_pages << page;
+    const int slot = page->allocate(image);
+    return slot >= 0 ? new AtlasTexture(page, slot) : nullptr;
+}
+
+qint64 TextureAtlas::memoryUsage() const
+{
+    qint64 bytes = 0;
+    for (const auto &page : m_pages) {
+        bytes += qint64(page->size().width()) * page->size().height() * 4;
+    }
+    return bytes;
+}
@@ -0,0 +1,189 @@
+/*
+ *  SPDX-FileCopyrightText: 2020 The KDE Community
+ *
+ *  SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QImage>
+#include <QOpenGLContext>
+#include <QPointer>
+#include <QRect>
+#include <QSGTexture>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QVector>
+
+class QQuickWindow;
+
+/**
+ * Places rectangles on a page, in horizontal shelves of similar height.
+ */
+class ShelfPacker
+{
+public:
+    explicit ShelfPacker(const QSize &size = QSize());
+
+    bool place(const QSize &size, QPoint *position);
+    void release(const QRect &rect);
+
+private:
+    struct Span {
+        int x;
+        int width;
+    };
+    struct Shelf {
+        int y;
+        int height;
+        int slots;
+        QVector<Span> free;
+    };
+
+    QSize m_size;
+    int m_nextY = 0;
+    QVector<Shelf> m_shelves;
+};
+
+/**
+ * One texture of the atlas, containing many small images.
+ *
+ * Pages can only be used in the render thread, while the OpenGL context of
+ * their window is current. Their texture is deleted by invalidate(), never by
+ * the destructor: the last AtlasTexture using a page can go away anywhere.
+ */
+class TextureAtlasPage
+{
+public:
+    TextureAtlasPage(QQuickWindow *window, const QSize &size);
+    ~TextureAtlasPage();
+
+    /**
+     * Copies @p image in the page.
+     *
+     * @returns the slot of the image in the page, or -1 if there isn't enough room left
+     */
+    int allocate(const QImage &image);
+    void release(int slot);
+
+    /**
+     * Packs the images again together with @p image, to make room for it.
+     *
+     * Nothing is moved unless @p image then fits. The position of the images
+     * changes, which is tracked by generation().
+     *
+     * @returns the slot of the image in the page, or -1 if it doesn't fit even after packing
+     */
+    int defragmentAndAllocate(const QImage &image);
+
+    /**
+     * Deletes the texture, if the context it was created in is the current one.
+     *
+     * Must be called in the render thread, before the context goes away.
+     */
+    void invalidate();
+
+    bool isEmpty() const;
+    bool isFragmented(const QSize &size) const;
+
+    QRect slotRect(int slot) const;
+    QImage slotImage(int slot) const;
+
+    QQuickWindow *window() const;
+    QSize size() const;
+    int textureId() const;
+    int generation() const;
+    void bind();
+
+private:
+    struct Slot {
+        QRect rect;
+        QImage image;
+    };
+
+    int addSlot(const QImage &image, const QPoint &position);
+    void upload(const Slot &slot);
+
+    QQuickWindow *m_window;
+    QPointer<QOpenGLContext> m_context;
+    QSize m_size;
+    uint m_textureId = 0;
+    int m_generation = 0;
+    int m_usedArea = 0;
+    int m_liveSlots = 0;
+    ShelfPacker m_packer;
+    QVector<Slot> m_slots;
+    QVector<int> m_freeSlots;
+};
+
+/**
+ * A texture which is a part of an atlas page shared with other images.
+ *
+ * All the textures of a page share the same texture id, so the scene graph
+ * can draw them in a single batch.
+ */
+class AtlasTexture : public QSGTexture
+{
+public:
+    AtlasTexture(const QSharedPointer<TextureAtlasPage> &page, int slot);
+    ~AtlasTexture() override;
+
+    int textureId() const override;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    int comparisonKey() const override;
+#endif
+    QSize textureSize() const override;
+    bool hasAlphaChannel() const override;
+    bool hasMipmaps() const override;
+    QRectF normalizedTextureSubRect() const override;
+    bool isAtlasTexture() const override;
+    QSGTexture *removedFromAtlas() const override;
+    void bind() override;
+
+    /**
+     * Changes every time the texture moves in its page, nodes using it then
+     * need to update their texture coordinates.
+     */
+    int generation() const;
+
+private:
+    QSharedPointer<TextureAtlasPage> m_page;
+    int m_slot;
+    mutable QScopedPointer<QSGTexture> m_standalone;
+};
+
+/**
+ * The atlas of small images of a window.
+ *
+ * Must be deleted in the render thread of the window, while its context is
+ * still current, so the pages can delete their textures.
+ */
+class TextureAtlas
+{
+public:
+    explicit TextureAtlas(QQuickWindow *window);
+    ~TextureAtlas();
+
+    /**
+     * Whether @p image can be placed in the atlas of @p window.
+     *
+     * Only small images can, with the OpenGL renderer.
+     */
+    static bool canUseAtlas(QQuickWindow *window, const QImage &image);
+
+    /**
+     * @returns a texture for @p image in one of the pages of the atlas, or
+     * nullptr if the atlas is full.
+     */
+    QSGTexture *createTexture(const QImage &image);
+
+    /**
+     * @returns the memory used by the textures of the pages, in bytes, whether
+     * their images are in use or not.
+     */
+    qint64 memoryUsage() const;
+
+private:
+    QQuickWindow *m_window;
+    QVector<QSharedPointer<TextureAtlasPage>> m_pages;
+};